@@ -36,21 +36,339 @@
 
 /** Types **/
 
+/* Uniform setter, which uploads 'count' densely packed values to the uniform at 'loc'
+ * Matrices are packed row-major (i.e. in the same order as 'nx' arrays)
+ */
+typedef void (*ksgl_uniform_setter)(int loc, int count, const void* data);
+
+/* Raw bytes of an object being uploaded, which may point directly into the object (see 'ksgl_data_get()')
+ *
+ */
+struct ksgl_data {
+
+    /* Pointer to the bytes, and the number of bytes */
+    const void* data;
+    ks_size_t len;
+
+    /* Reference that keeps 'data' valid, or NULL if 'data' is the scratch buffer */
+    kso ref;
+
+};
+
+/* Active uniform within a shader program, queried once when the program is linked
+ *
+ */
+struct ksgl_shader_uniform {
+
+    /* Name of the uniform, as it may be looked up (i.e. 'uM', 'uBones[3]') */
+    ks_str name;
+
+    /* Location of the uniform, or -1 if it is a member of a uniform block */
+    int loc;
+
+    /* OpenGL type (GL_FLOAT_MAT4, GL_SAMPLER_2D, etc) */
+    int type;
+
+    /* Number of array elements starting at 'loc' (1 for non-arrays) */
+    int size;
+
+    /* Shape of a single element, as an 'nx' array (vectors are '1' row) */
+    int rows, cols;
+
+    /* Size (in bytes) of a single element */
+    int elsize;
+
+    /* Kind of values, 'f' (float), 'i' (int, bool, or sampler) or 'u' (unsigned int) */
+    char kind;
+
+    /* Byte offset of this uniform's value in the program's shadow state */
+    int offset;
+
+    /* Function that uploads values, or NULL if the type is not supported */
+    ksgl_uniform_setter set;
+
+    /* Index of the active uniform (for 'glGetActiveUniformsiv()') */
+    int index;
+
+    /* Array element this entry refers to, or -1 if it is the uniform itself */
+    int elem;
+
+    /* Index of the uniform block this is a member of (in the program's 'blocks'), or -1 */
+    int block;
+
+};
+
+/* Active uniform block within a shader program, queried once when the program is linked
+ *
+ */
+struct ksgl_shader_block {
+
+    /* Name of the block */
+    ks_str name;
+
+    /* Index of the block (for 'glUniformBlockBinding()') */
+    int index;
+
+    /* Binding point the block reads from */
+    int binding;
+
+    /* Size (in bytes) of the block's data */
+    int size;
+
+};
+
+/* Linked OpenGL program, and information queried from it once it was linked
+ * Programs are shared by all 'gl.Shader' objects created from the same sources
+ */
+struct ksgl_program {
+
+    /* Number of 'gl.Shader' objects using this program */
+    int refs;
+
+    /* Hash of the sources, and the sources themselves
+     * For compute programs, 'src_vert' is the compute shader, and 'src_frag' is NULL
+     */
+    ks_hash_t key;
+    ks_str src_vert, src_frag;
+
+    /* Context the program was created in, since programs are only shared within it */
+    void* ctx;
+
+    /* OpenGL handle for the program
+     * Created via 'glCreateProgram()'
+     */
+    int val;
+
+    /* Shaders attached to 'val' while it is being built asynchronously (or -1), whose status
+     *   is checked by 'ksgl_shader_ready()'
+     */
+    int sh_vert, sh_frag;
+
+    /* Whether the compile and link status have yet to be checked, and whether they failed */
+    bool pending, failed;
+
+    /* Number of active uniforms, and their information */
+    int n_uniforms;
+    struct ksgl_shader_uniform* uniforms;
+
+    /* Hash table mapping uniform names to indices in 'uniforms', where empty buckets
+     *   are -1. 'n_buckets' is always a power of 2
+     */
+    int n_buckets;
+    int* buckets;
+
+    /* Shadow copy of the last uploaded value of every uniform (see 'offset' on each uniform),
+     *   which is used to skip uploads that would not change anything
+     */
+    int n_shadow;
+    unsigned char* shadow;
+
+    /* Number of active uniform blocks, and their information */
+    int n_blocks;
+    struct ksgl_shader_block* blocks;
+
+    /* Reflection of active uniforms, vertex attributes and uniform blocks, as dicts of names
+     *   to tuples (see 'gl.Shader.uniforms', etc)
+     */
+    ks_dict refl_uniforms, refl_attributes, refl_blocks;
+
+};
+
 /* gl.Shader(src_vert) - OpenGL shader program
  *
  */
 typedef struct ksgl_shader_s {
     KSO_BASE
     
-    /* OpenGL handle for the program 
-     * Created via 'glCreateProgram()'
+    /* OpenGL handle for the program (same as 'prog->val')
      */
     int val;
 
+    /* Program being used, which may be shared with other shaders */
+    struct ksgl_program* prog;
+
+    /* Number of uploads that were skipped (hits) and actually issued (misses) */
+    ks_cint n_hits, n_misses;
+
 }* ksgl_shader;
 
+/* gl.ComputeShader(src) - OpenGL compute shader program (a subtype of 'gl.Shader')
+ *
+ * Uses 'struct ksgl_shader_s', with a program that has no fragment source
+ */
+
+/* gl.Uniform - Handle to a single uniform of a shader program, created with 'Shader.handle(name)'
+ *
+ */
+typedef struct ksgl_uniform_s {
+    KSO_BASE
+
+    /* Shader program the uniform belongs to */
+    ksgl_shader shader;
+
+    /* Entry in the shader's uniform table */
+    struct ksgl_shader_uniform* val;
+
+}* ksgl_uniform;
+
+
+/* gl.ShaderLibrary(src_vert, src_frag, flags) - Variants of a shader, built from the same sources with
+ *   different sets of '#define'd feature flags
+ *
+ */
+typedef struct ksgl_shaderlibrary_s {
+    KSO_BASE
+
+    /* Base sources, without any flags defined */
+    ks_str src_vert, src_frag;
+
+    /* Names of the feature flags, where flag 'i' is bit '1 << i' of a variant mask */
+    ks_tuple flags;
+
+    /* Number of variants that have been built, and their masks and shaders */
+    int n_variants;
+    ks_cint* masks;
+    ksgl_shader* variants;
+
+}* ksgl_shaderlibrary;
+
+/* Member of a uniform block, with its std140 layout
+ *
+ */
+struct ksgl_ubo_member {
+
+    /* Name of the member, without the block prefix */
+    ks_str name;
+
+    /* OpenGL type, and number of array elements */
+    int type, size;
+
+    /* Shape of a single element, as an 'nx' array, and kind of values (see 'ksgl_shader_uniform') */
+    int rows, cols;
+    char kind;
+
+    /* Byte offset within the block, and strides between array elements, and matrix columns (or rows) */
+    int offset, astride, mstride;
+
+    /* Whether matrices are stored row-major */
+    bool rowmajor;
+
+};
+
+/* gl.UBO(shader, block) - OpenGL uniform buffer object, laid out for a uniform block
+ *
+ */
+typedef struct ksgl_ubo_s {
+    KSO_BASE
+
+    /* OpenGL handle for the buffer
+     */
+    int val;
+
+    /* Name of the uniform block */
+    ks_str block;
+
+    /* Size (in bytes) of the block, and CPU-side copy of its data */
+    int size;
+    unsigned char* data;
+
+    /* Number of members, and their layout */
+    int n_members;
+    struct ksgl_ubo_member* members;
+
+}* ksgl_ubo;
+
+/* gl.UniformRing(size=4MB, nregions=3) - Ring of per-draw uniform blocks in one large buffer
+ *
+ */
+typedef struct ksgl_uniformring_s {
+    KSO_BASE
+
+    /* OpenGL handle for the buffer
+     */
+    int val;
+
+    /* Size (in bytes) of the buffer, and alignment of each slice */
+    int size, align;
 
-/* gl.VBO(data='') - OpenGL vertex buffer object
+    /* Number of regions the buffer is split into, and a fence for each one (NULL if the
+     *   region is not in use by the GPU)
+     */
+    int n_regions;
+    GLsync* fences;
+
+    /* Current region, and next free byte offset within the buffer */
+    int region, head;
+
+    /* Number of times writing had to wait for the GPU */
+    ks_cint n_waits;
+
+}* ksgl_uniformring;
+
+/* Ways of writing to a buffer (see 'gl.VBO.write()')
+ */
+#define KSGL_WRITE_SUBDATA      0
+#define KSGL_WRITE_ORPHAN       1
+#define KSGL_WRITE_INVALIDATE   2
+#define KSGL_WRITE_UNSYNC       3
+#define KSGL_WRITE_N            4
+
+/* Kinds of OpenGL objects, for deferred deletion (see 'ksgl_delete()')
+ * Sync objects are pointers rather than names, so they are queued with 'ksgl_delete_sync()'
+ */
+#define KSGL_OBJ_BUFFER         0
+#define KSGL_OBJ_TEXTURE        1
+#define KSGL_OBJ_VERTEXARRAY    2
+#define KSGL_OBJ_PROGRAM        3
+#define KSGL_OBJ_SHADER         4
+#define KSGL_OBJ_SYNC           5
+#define KSGL_OBJ_N              6
+
+/* gl.StreamBuffer(size=16MB, nregions=3) - Ring of per-frame regions in one large buffer, for streaming
+ *   dynamic vertex data
+ *
+ */
+typedef struct ksgl_streambuffer_s {
+    KSO_BASE
+
+    /* OpenGL handle for the buffer
+     */
+    int val;
+
+    /* Size (in bytes) of the buffer, and alignment of each allocation */
+    ks_ssize_t size;
+    int align;
+
+    /* Number of regions the buffer is split into, and a fence for each one (NULL if the
+     *   region is not in use by the GPU)
+     */
+    int n_regions;
+    GLsync* fences;
+
+    /* Current region, and next free byte offset within the buffer */
+    int region;
+    ks_ssize_t head;
+
+    /* Mapped memory, which starts at byte 'map_offset' of the buffer (or NULL if it is not mapped)
+     * For persistent buffers, the entire buffer is mapped once. Otherwise, the rest of the current region
+     *   is mapped on the first allocation, and unmapped by 'flush()'
+     */
+    unsigned char* map;
+    ks_ssize_t map_offset;
+    bool persistent;
+
+    /* Views returned by 'alloc()' since the last flush, for non-persistent buffers, which must not be in use
+     *   when the region is unmapped (each one references the buffer, so they are released by 'flush()')
+     */
+    int n_views, max_views;
+    kso* views;
+
+    /* Number of times allocating had to wait for the GPU */
+    ks_cint n_waits;
+
+}* ksgl_streambuffer;
+
+/* gl.VBO(data='', usage=gl.STATIC_DRAW, persistent=false) - OpenGL vertex buffer object
  *
  */
 typedef struct ksgl_vbo_s {
@@ -60,9 +378,133 @@ typedef struct ksgl_vbo_s {
      */
     int val;
 
+    /* Size of the buffer, in bytes */
+    ks_ssize_t size;
+
+    /* Mapped memory of the buffer (or NULL if it is not mapped), and the byte offset it starts at
+     * For persistent buffers, the entire buffer is mapped once, and stays mapped
+     */
+    void* map;
+    ks_ssize_t map_offset;
+    bool persistent;
+
+    /* Object that views from 'map()' of a non-persistent buffer reference (or NULL, once none of them are
+     *   alive), which 'unmap()' checks before invalidating them
+     * It references the buffer, but this is a borrowed reference (cleared when it is freed), so a buffer that is
+     *   never unmapped is not kept alive by it
+     */
+    kso map_ref;
+
+    /* Usage hint given when created (i.e. GL_STATIC_DRAW), used when orphaning */
+    int usage;
+
+    /* Number of writes, number of them that stalled, and total time spent (in seconds), for each
+     *   way of writing (KSGL_WRITE_*)
+     */
+    ks_cint n_writes[KSGL_WRITE_N], n_stalls[KSGL_WRITE_N];
+    double t_writes[KSGL_WRITE_N];
+
 }* ksgl_vbo;
 
-/* gl.EBO(data='') - OpenGL element buffer object
+/* Byte range [start, end) of a buffer which has been modified
+ */
+struct ksgl_dirty {
+    ks_ssize_t start, end;
+};
+
+/* gl.ShadowVBO(data, usage=gl.DYNAMIC_DRAW, gap=256, full=0.5) - Vertex buffer with a CPU-side mirror,
+ *   which uploads modified ranges in as few calls as possible
+ *
+ * This is a subtype of 'gl.VBO', so it can be used anywhere a buffer is expected
+ */
+typedef struct ksgl_shadowvbo_s {
+    struct ksgl_vbo_s vbo;
+
+    /* Mirror of the buffer contents (an 'nx.array' of the same size, in bytes) */
+    nx_array data;
+
+    /* Ranges modified since the last flush, in the order they were recorded */
+    int n_dirty, max_dirty;
+    struct ksgl_dirty* dirty;
+
+    /* Flush policy: ranges less than 'gap' bytes apart are uploaded as one, and if more than 'full'
+     *   (a fraction of the size) would be uploaded, the whole buffer is uploaded at once instead
+     */
+    ks_ssize_t gap;
+    double full;
+
+    /* Number of flushes, uploads they made, and bytes they uploaded */
+    ks_cint n_flushes, n_uploads, n_bytes;
+
+}* ksgl_shadowvbo;
+
+/* Range of bytes within a block of a 'gl.BufferArena'
+ */
+struct ksgl_arena_range {
+    ks_ssize_t offset, size;
+
+    /* For allocated ranges, the multiple the offset is kept at (the arena's alignment, and the vertex stride) */
+    ks_ssize_t unit;
+};
+
+/* Block of a 'gl.BufferArena', which is a single buffer that allocations are made from
+ */
+struct ksgl_arena_block {
+
+    /* Buffer being suballocated */
+    ksgl_vbo buf;
+
+    /* Free ranges, sorted by offset (adjacent ranges are always merged) */
+    int n_free, max_free;
+    struct ksgl_arena_range* free;
+
+    /* Allocated ranges, sorted by offset */
+    int n_used, max_used;
+    struct ksgl_arena_range* used;
+
+};
+
+/* gl.BufferArena(block_size=64MB, align=256, usage=gl.STATIC_DRAW) - Suballocator of slices of a few large buffers
+ *
+ */
+typedef struct ksgl_bufferarena_s {
+    KSO_BASE
+
+    /* Default size of each block, alignment of allocations, and usage hint of the buffers */
+    ks_ssize_t block_size;
+    int align, usage;
+
+    /* Number of blocks, and the blocks */
+    int n_blocks;
+    struct ksgl_arena_block* blocks;
+
+}* ksgl_bufferarena;
+
+/* gl.Readback - Pending copy of buffer contents back to the CPU, created with 'VBO.read_async()'
+ *
+ */
+typedef struct ksgl_readback_s {
+    KSO_BASE
+
+    /* OpenGL handle for the staging buffer that is copied into (or -1 once the result has been read)
+     */
+    int val;
+
+    /* Number of bytes being read */
+    ks_ssize_t size;
+
+    /* Fence signaled once the copy is done (NULL once it has been waited on) */
+    GLsync fence;
+
+    /* Type of the result's elements, or NULL to return bytes */
+    nx_dtype dtype;
+
+    /* Result, once it has been read (or NULL) */
+    kso result;
+
+}* ksgl_readback;
+
+/* gl.EBO(data='', usage=gl.STATIC_DRAW, narrow=false) - OpenGL element buffer object
  *
  */
 typedef struct ksgl_ebo_s {
@@ -72,6 +514,10 @@ typedef struct ksgl_ebo_s {
      */
     int val;
 
+    /* Type of the indices stored (i.e. GL_UNSIGNED_SHORT), and the number of them */
+    int itype;
+    ks_ssize_t num;
+
 }* ksgl_ebo;
 
 /* gl.VAO() - OpenGL vertex array object
@@ -84,6 +530,9 @@ typedef struct ksgl_vao_s {
      */
     int val;
 
+    /* Number of attribute indices used by 'gl.VAO.layout()', which the next layout starts after */
+    int n_layout;
+
 }* ksgl_vao;
 
 
@@ -109,11 +558,157 @@ typedef struct ksgl_texture2d_s {
 bool ksgl_check();
 
 
+/* Returns whether the current context supports OpenGL version 'major.minor'
+ * The version is read again whenever a window's context is made current (see 'ksgl_version_update()')
+ */
+bool ksgl_version(int major, int minor);
+
+/* Re-read the version (and entry points) of the current context, which must be called whenever a context
+ *   is made current, since 'gl3wInit()' runs before any context exists
+ */
+bool ksgl_version_update();
+
+/* Returns whether the current context supports an extension (i.e. 'GL_KHR_parallel_shader_compile')
+ */
+bool ksgl_hasext(const char* name);
+
+/* Returns whether immutable buffer storage (and so persistent mapping) is supported, which requires
+ *   OpenGL v4.4 or 'ARB_buffer_storage'
+ */
+bool ksgl_hasstorage();
+
+/* Returns the current context (or NULL), which objects are created in and deleted from
+ */
+void* ksgl_context();
+
+/* Returns a monotonic time, in seconds
+ */
+double ksgl_time();
+
+/* Queue the object 'name' of a given kind (KSGL_OBJ_*) to be deleted at the next safe point (see
+ *   'ksgl_delete_flush()'), so it is never deleted from the garbage collector mid-frame, or without a context
+ * Objects are queued for the context that is current, which must be the one they were created in. Objects
+ *   freed while no context is current are never deleted (they are leaked)
+ * If 'recycle' is true, the name may be kept in a pool and returned by 'ksgl_genbuffer()' instead (only
+ *   buffers with mutable storage should be recycled)
+ */
+void ksgl_delete(int kind, GLuint name, bool recycle);
+
+/* Queue a sync object (KSGL_OBJ_SYNC) to be deleted at the next safe point, like 'ksgl_delete()'
+ * Does nothing if 'fence' is NULL
+ */
+void ksgl_delete_sync(GLsync fence);
+
+/* Delete all objects queued for the current context (in one call per kind)
+ */
+bool ksgl_delete_flush();
+
+/* Discard the queue and pool of a context that is being destroyed (which deletes its objects anyway)
+ */
+void ksgl_delete_drop(void* ctx);
+
+/* Set the maximum number of buffer names kept for reuse, per context (0 disables pooling)
+ */
+void ksgl_pool_setmax(ks_ssize_t max);
+
+/* Return a name for a new buffer, reusing a name pooled for the current context if possible
+ */
+GLuint ksgl_genbuffer();
+
 /* Convert arguments to a color (RGBA)
  * 'out' should store '4' values
  */
 bool ksgl_getcolor(int nargs, kso* args, ks_cfloat* out);
 
+/* Returns whether an array is dense and row-major (C-order)
+ */
+bool ksgl_contig(nx_t x);
+
+/* Copy the elements of an array into 'out' as a dense, row-major array
+ */
+void ksgl_pack(nx_t x, void* out);
+
+/* Create a new (uninitialized) buffer of 'size' bytes
+ */
+ksgl_vbo ksgl_vbo_new(ks_ssize_t size, int usage);
+
+/* Initialize a (non-persistent) buffer, or a subtype, with 'size' bytes from 'data' (which may be NULL)
+ */
+bool ksgl_vbo_init(ksgl_vbo self, ks_ssize_t size, const void* data, int usage);
+
+/* Write 'len' bytes to a buffer at 'offset', in a given way (KSGL_WRITE_*), and record whether it stalled
+ */
+bool ksgl_vbo_write(ksgl_vbo self, ks_ssize_t offset, const void* data, ks_ssize_t len, int mode);
+
+/* Resize a buffer to 'size' bytes, keeping its handle. If 'preserve' is true, the contents (up to the
+ *   smaller of the sizes) are kept, by copying on the GPU
+ */
+bool ksgl_vbo_resize(ksgl_vbo self, ks_ssize_t size, bool preserve);
+
+/* Start copying 'size' bytes at 'offset' of the buffer 'buf' into a staging buffer, returning a 'gl.Readback'
+ *   for the result (which is an array of 'dtype', or bytes if it is NULL)
+ */
+ksgl_readback ksgl_readback_new(int buf, ks_ssize_t offset, ks_ssize_t size, nx_dtype dtype);
+
+/* Get a dense array to read into from 'obj', which must be an 'nx' array (or view) in row-major order
+ * The data of 'out' points into 'obj', so it is valid as long as 'obj' is
+ */
+bool ksgl_getout(kso obj, nx_t* out);
+
+/* Get the raw bytes of 'obj' to upload, without copying them if possible
+ * Dense 'nx' arrays are used in place, and strided ones are packed into a scratch buffer which is
+ *   reused between calls. Other objects are converted with 'kso_bytes()'
+ * 'ksgl_data_done()' must be called once the bytes have been uploaded
+ */
+bool ksgl_data_get(kso obj, struct ksgl_data* out);
+void ksgl_data_done(struct ksgl_data* d);
+
+/* Wait for '*fence' to be signaled (if it is not NULL), then delete it and set it to NULL
+ * If 'nwaits' is given, it is incremented if the CPU actually had to block
+ */
+bool ksgl_fence_wait(GLsync* fence, ks_cint* nwaits);
+
+/* Create a new shader from sources (see 'gl.Shader.compile_async()' for when 'wait' is false)
+ */
+ksgl_shader ksgl_shader_new(ks_str src_vert, ks_str src_frag, bool wait);
+
+/* Initialize a shader (or a subtype) from sources. If 'src_frag' is NULL, 'src_vert' is compiled as
+ *   a compute shader
+ */
+bool ksgl_shader_init(ksgl_shader self, ks_str src_vert, ks_str src_frag, bool wait);
+
+/* Wait for the program of 'self' to finish building (if it was compiled asynchronously), and
+ *   check its status. This must be called before the uniform table or blocks are used
+ */
+bool ksgl_shader_ready(ksgl_shader self);
+
+/* Look up an active uniform by name, returning NULL (without throwing) if it does not exist
+ * Does not call into OpenGL
+ */
+struct ksgl_shader_uniform* ksgl_shader_getuniform(ksgl_shader self, ks_str name);
+
+/* Look up an active uniform block by name, returning NULL (without throwing) if it does not exist
+ */
+struct ksgl_shader_block* ksgl_shader_getblock(ksgl_shader self, ks_str name);
+
+/* Pack 'vals' (a dict of member names to values, or raw bytes) into the CPU copy of the block
+ */
+bool ksgl_ubo_pack(ksgl_ubo self, kso vals);
+
+/* Upload 'count' densely packed elements to a uniform of 'self', unless they are equal to the
+ *   shadowed values. If another program is in use, this one is used for the upload, and then restored
+ */
+void ksgl_shader_setuniform(ksgl_shader self, struct ksgl_shader_uniform* u, int count, const void* data);
+
+/* Convert 'val' to the uniform 'u' of 'self' and upload it (see 'ksgl_shader_setuniform()')
+ * Dense row-major arrays of the right type are passed to OpenGL without copying
+ */
+bool ksgl_shader_upload(ksgl_shader self, struct ksgl_shader_uniform* u, kso val);
+
+/* Unregister the programs of a context that is being destroyed, so they are never shared (or deleted) again
+ */
+void ksgl_shader_drop(void* ctx);
+
 
 
 #ifdef KSGL_GLFW
@@ -201,9 +796,18 @@ typedef struct ksgl_ai_scene_s {
 
 ks_type
     ksglt_vbo,
+    ksglt_ubo,
+    ksglt_uniformring,
+    ksglt_streambuffer,
+    ksglt_readback,
+    ksglt_bufferarena,
+    ksglt_shadowvbo,
     ksglt_ebo,
     ksglt_vao,
     ksglt_shader,
+    ksglt_shaderlibrary,
+    ksglt_computeshader,
+    ksglt_uniform,
     ksglt_texture1d,
     ksglt_texture2d,
     ksglt_texture3d,
@@ -225,8 +829,17 @@ ks_module _ksgl_util();
 ks_module _ksgl_ai();
 
 void _ksgl_shader();
+void _ksgl_shaderlibrary();
+void _ksgl_computeshader();
+void _ksgl_uniform();
 void _ksgl_texture2d();
 void _ksgl_vbo();
+void _ksgl_ubo();
+void _ksgl_uniformring();
+void _ksgl_streambuffer();
+void _ksgl_readback();
+void _ksgl_bufferarena();
+void _ksgl_shadowvbo();
 void _ksgl_vao();
 void _ksgl_ebo();
 
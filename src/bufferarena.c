@@ -0,0 +1,389 @@
+/* bufferarena.c - gl.BufferArena type
+ *
+ * @author: Cade Brown <cade@kscript.org>
+ */
+#include <ksgl.h>
+
+#define T_NAME M_NAME ".BufferArena"
+
+
+/* Internals */
+
+/* Default size of each block */
+#define KSGL_ARENA_BLOCK (64 * 1024 * 1024)
+
+/* Round 'x' up to a multiple of 'm'
+ */
+static ks_ssize_t my_roundup(ks_ssize_t x, ks_ssize_t m) {
+    return (x + m - 1) / m * m;
+}
+
+/* Return the least common multiple of 'a' and 'b'
+ */
+static ks_ssize_t my_lcm(ks_ssize_t a, ks_ssize_t b) {
+    ks_ssize_t x = a, y = b;
+    while (y != 0) {
+        ks_ssize_t t = x % y;
+        x = y;
+        y = t;
+    }
+
+    return a / x * b;
+}
+
+/* Insert 'r' at index 'i' of a range array, growing it if needed
+ */
+static bool my_insert(struct ksgl_arena_range** arr, int* n, int* max, int i, struct ksgl_arena_range r) {
+    if (*n >= *max) {
+        int nmax = *max * 2 + 8;
+        struct ksgl_arena_range* p = ks_realloc(*arr, sizeof(**arr) * nmax);
+        if (!p) {
+            KS_THROW(kst_Error, "Failed to allocate data");
+            return false;
+        }
+        *arr = p;
+        *max = nmax;
+    }
+
+    memmove(*arr + i + 1, *arr + i, sizeof(**arr) * (*n - i));
+    (*arr)[i] = r;
+    (*n)++;
+    return true;
+}
+
+/* Remove the range at index 'i' of a range array
+ */
+static void my_remove(struct ksgl_arena_range* arr, int* n, int i) {
+    memmove(arr + i, arr + i + 1, sizeof(*arr) * (*n - i - 1));
+    (*n)--;
+}
+
+/* Return the index of the first range whose offset is at least 'offset'
+ */
+static int my_search(struct ksgl_arena_range* arr, int n, ks_ssize_t offset) {
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (arr[mid].offset < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/* Return a range to the free list of a block, merging it with adjacent free ranges
+ */
+static bool my_release(struct ksgl_arena_block* b, struct ksgl_arena_range r) {
+    int i = my_search(b->free, b->n_free, r.offset);
+    bool prev = i > 0 && b->free[i - 1].offset + b->free[i - 1].size == r.offset;
+    bool next = i < b->n_free && r.offset + r.size == b->free[i].offset;
+
+    if (prev && next) {
+        b->free[i - 1].size += r.size + b->free[i].size;
+        my_remove(b->free, &b->n_free, i);
+    } else if (prev) {
+        b->free[i - 1].size += r.size;
+    } else if (next) {
+        b->free[i].offset = r.offset;
+        b->free[i].size += r.size;
+    } else {
+        return my_insert(&b->free, &b->n_free, &b->max_free, i, r);
+    }
+
+    return true;
+}
+
+/* Add a new block with a buffer of 'size' bytes, which is entirely free
+ */
+static struct ksgl_arena_block* my_addblock(ksgl_bufferarena self, ks_ssize_t size) {
+    struct ksgl_arena_block* blocks = ks_realloc(self->blocks, sizeof(*self->blocks) * (self->n_blocks + 1));
+    if (!blocks) {
+        KS_THROW(kst_Error, "Failed to allocate data");
+        return NULL;
+    }
+    self->blocks = blocks;
+
+    struct ksgl_arena_block* b = &self->blocks[self->n_blocks];
+    b->n_free = b->max_free = 0;
+    b->free = NULL;
+    b->n_used = b->max_used = 0;
+    b->used = NULL;
+
+    b->buf = ksgl_vbo_new(size, self->usage);
+    if (!b->buf) {
+        return NULL;
+    }
+
+    if (!my_insert(&b->free, &b->n_free, &b->max_free, 0, (struct ksgl_arena_range){ 0, size })) {
+        KS_DECREF(b->buf);
+        return NULL;
+    }
+
+    self->n_blocks++;
+    return b;
+}
+
+
+/* C-API */
+
+/* Type Functions */
+
+static KS_TFUNC(T, free) {
+    ksgl_bufferarena self;
+    KS_ARGS("self:*", &self, ksglt_bufferarena);
+
+    int i;
+    for (i = 0; i < self->n_blocks; ++i) {
+        KS_DECREF(self->blocks[i].buf);
+        ks_free(self->blocks[i].free);
+        ks_free(self->blocks[i].used);
+    }
+    ks_free(self->blocks);
+
+    KSO_DEL(self);
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, init) {
+    ksgl_bufferarena self;
+    ks_cint block_size = KSGL_ARENA_BLOCK, align = 256, usage = GL_STATIC_DRAW;
+    KS_ARGS("self:* ?block_size:cint ?align:cint ?usage:cint", &self, ksglt_bufferarena, &block_size, &align, &usage);
+
+    self->n_blocks = 0;
+    self->blocks = NULL;
+
+    if (block_size <= 0 || align <= 0) {
+        KS_THROW(kst_Error, "'block_size' and 'align' must be positive");
+        return NULL;
+    }
+    self->block_size = block_size;
+    self->align = align;
+    self->usage = usage;
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, getattr) {
+    ksgl_bufferarena self;
+    ks_str attr;
+    KS_ARGS("self:* attr:*", &self, ksglt_bufferarena, &attr, kst_str);
+
+    int i, j;
+    if (ks_str_eq_c(attr, "blocks", 6)) {
+        ks_list res = ks_list_new(0, NULL);
+        for (i = 0; i < self->n_blocks; ++i) {
+            ks_list_push(res, (kso)self->blocks[i].buf);
+        }
+        return (kso)res;
+    } else if (ks_str_eq_c(attr, "used", 4) || ks_str_eq_c(attr, "free", 4)) {
+        bool used = attr->data[0] == 'u';
+        ks_cint res = 0;
+        for (i = 0; i < self->n_blocks; ++i) {
+            struct ksgl_arena_block* b = &self->blocks[i];
+            int n = used ? b->n_used : b->n_free;
+            struct ksgl_arena_range* r = used ? b->used : b->free;
+            for (j = 0; j < n; ++j) {
+                res += r[j].size;
+            }
+        }
+        return (kso)ks_int_new(res);
+    }
+
+    KS_THROW_ATTR(self, attr);
+    return NULL;
+}
+
+static KS_TFUNC(T, alloc) {
+    ksgl_bufferarena self;
+    ks_cint size, stride = 1;
+    KS_ARGS("self:* size:cint ?stride:cint", &self, ksglt_bufferarena, &size, &stride);
+
+    if (size <= 0) {
+        KS_THROW(kst_Error, "Allocation size must be positive, but got %i", (int)size);
+        return NULL;
+    } else if (stride <= 0) {
+        KS_THROW(kst_Error, "Stride must be positive, but got %i", (int)stride);
+        return NULL;
+    }
+
+    /* Round up, so every offset stays aligned */
+    ks_ssize_t sz = my_roundup(size, self->align);
+
+    /* The offset must also be a multiple of the stride, so it is a whole number of vertices */
+    ks_ssize_t unit = my_lcm(self->align, stride);
+
+    /* Find the smallest free range that fits (after moving its start up to a multiple of 'unit') */
+    int i, j, bi = -1, fi = -1;
+    for (i = 0; i < self->n_blocks; ++i) {
+        struct ksgl_arena_block* b = &self->blocks[i];
+        for (j = 0; j < b->n_free; ++j) {
+            struct ksgl_arena_range* f = &b->free[j];
+            if (my_roundup(f->offset, unit) + sz <= f->offset + f->size && (bi < 0 || f->size < self->blocks[bi].free[fi].size)) {
+                bi = i;
+                fi = j;
+            }
+        }
+    }
+
+    if (bi < 0) {
+        /* Nothing fits, so add a block (which may be larger than usual, for large allocations) */
+        if (!my_addblock(self, sz > self->block_size ? sz : self->block_size)) {
+            return NULL;
+        }
+        bi = self->n_blocks - 1;
+        fi = 0;
+    }
+
+    struct ksgl_arena_block* b = &self->blocks[bi];
+    struct ksgl_arena_range f = b->free[fi];
+    struct ksgl_arena_range r = { my_roundup(f.offset, unit), sz, unit };
+    ks_ssize_t gap = r.offset - f.offset, rest = f.offset + f.size - (r.offset + sz);
+    if (gap == 0) {
+        b->free[fi].offset += sz;
+        b->free[fi].size -= sz;
+        if (b->free[fi].size == 0) {
+            my_remove(b->free, &b->n_free, fi);
+        }
+    } else {
+        /* Keep the space skipped before the slice free, as well as the rest after it */
+        b->free[fi].size = gap;
+        if (rest > 0 && !my_insert(&b->free, &b->n_free, &b->max_free, fi + 1, (struct ksgl_arena_range){ r.offset + sz, rest })) {
+            b->free[fi].size = f.size;
+            return NULL;
+        }
+    }
+
+    if (!my_insert(&b->used, &b->n_used, &b->max_used, my_search(b->used, b->n_used, r.offset), r)) {
+        my_release(b, r);
+        return NULL;
+    }
+
+    return (kso)ks_tuple_newn(3, (kso[]) {
+        KS_NEWREF(b->buf),
+        (kso)ks_int_new(r.offset),
+        (kso)ks_int_new(r.size)
+    });
+}
+
+static KS_TFUNC(T, release) {
+    ksgl_bufferarena self;
+    ksgl_vbo buf;
+    ks_cint offset;
+    KS_ARGS("self:* buf:* offset:cint", &self, ksglt_bufferarena, &buf, ksglt_vbo, &offset);
+
+    int i;
+    for (i = 0; i < self->n_blocks; ++i) {
+        struct ksgl_arena_block* b = &self->blocks[i];
+        if (b->buf != buf) continue;
+
+        int j = my_search(b->used, b->n_used, offset);
+        if (j >= b->n_used || b->used[j].offset != offset) break;
+
+        struct ksgl_arena_range r = b->used[j];
+        my_remove(b->used, &b->n_used, j);
+        if (!my_release(b, r)) {
+            return NULL;
+        }
+
+        return KSO_NONE;
+    }
+
+    KS_THROW(kst_KeyError, "No allocation at offset %i of %R", (int)offset, buf);
+    return NULL;
+}
+
+static KS_TFUNC(T, defragment) {
+    ksgl_bufferarena self;
+    KS_ARGS("self:*", &self, ksglt_bufferarena);
+
+    ks_list res = ks_list_new(0, NULL);
+
+    int i, j;
+    for (i = 0; i < self->n_blocks; ++i) {
+        struct ksgl_arena_block* b = &self->blocks[i];
+
+        /* Already compact, with all free space at the end */
+        if (b->n_free == 0 || (b->n_free == 1 && b->free[0].offset + b->free[0].size == b->buf->size)) continue;
+
+        /* Where each slice goes, keeping its offset a multiple of its unit (so there may be small gaps) */
+        ks_ssize_t total = 0;
+        for (j = 0; j < b->n_used; ++j) {
+            total = my_roundup(total, b->used[j].unit) + b->used[j].size;
+        }
+
+        if (total > 0) {
+            /* Pack allocations into a temporary buffer (copies within a buffer may not overlap), then copy
+             *   them back to the start of the block
+             */
+            GLuint tmp;
+            glGenBuffers(1, &tmp);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, tmp);
+            glBufferData(GL_COPY_WRITE_BUFFER, total, NULL, GL_STREAM_COPY);
+            glBindBuffer(GL_COPY_READ_BUFFER, b->buf->val);
+
+            ks_ssize_t pos = 0;
+            for (j = 0; j < b->n_used; ++j) {
+                struct ksgl_arena_range* u = &b->used[j];
+                pos = my_roundup(pos, u->unit);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, u->offset, pos, u->size);
+                if (u->offset != pos) {
+                    /* Report the move, so users can update their references */
+                    ks_tuple t = ks_tuple_newn(4, (kso[]) {
+                        KS_NEWREF(b->buf),
+                        (kso)ks_int_new(u->offset),
+                        (kso)ks_int_new(pos),
+                        (kso)ks_int_new(u->size)
+                    });
+                    ks_list_push(res, (kso)t);
+                    KS_DECREF(t);
+                    u->offset = pos;
+                }
+                pos += u->size;
+            }
+
+            glBindBuffer(GL_COPY_READ_BUFFER, tmp);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, b->buf->val);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, total);
+            glDeleteBuffers(1, &tmp);
+        }
+
+        /* Free space is now the gaps between slices, and a single range at the end */
+        ks_ssize_t pos = 0;
+        b->n_free = 0;
+        for (j = 0; j <= b->n_used; ++j) {
+            ks_ssize_t next = j < b->n_used ? b->used[j].offset : b->buf->size;
+            if (next > pos && !my_insert(&b->free, &b->n_free, &b->max_free, b->n_free, (struct ksgl_arena_range){ pos, next - pos })) {
+                KS_DECREF(res);
+                return NULL;
+            }
+            if (j < b->n_used) pos = next + b->used[j].size;
+        }
+    }
+
+    if (!ksgl_check()) {
+        KS_DECREF(res);
+        return NULL;
+    }
+
+    return (kso)res;
+}
+
+
+/* Export */
+
+ks_type ksglt_bufferarena;
+
+void _ksgl_bufferarena() {
+    ksglt_bufferarena = ks_type_new(T_NAME, kst_object, sizeof(struct ksgl_bufferarena_s), -1, "Allocator of slices of a few large vertex/index buffers, so many small meshes can share buffers (and VAOs)", KS_IKV(
+        {"__free",                 ksf_wrap(T_free_, T_NAME ".__free(self)", "")},
+        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, block_size=64MB, align=256, usage=gl.STATIC_DRAW)", "Create an arena that allocates from buffers ('gl.VBO' objects) of 'block_size' bytes, with offsets and sizes rounded up to a multiple of 'align'")},
+        {"__getattr",              ksf_wrap(T_getattr_, T_NAME ".__getattr(self, attr)", "")},
+
+        {"alloc",                  ksf_wrap(T_alloc_, T_NAME ".alloc(self, size, stride=1)", "Allocate a slice of at least 'size' bytes (using the smallest free range that fits), returning a tuple of '(buf, offset, size)'. The offset is also a multiple of 'stride', so for vertex data, 'offset / stride' is the 'basevertex' for 'gl.draw_elements_base_vertex()'. Slices can be written with 'buf.write(data, offset)', and index slices are used with 'buf.bind(gl.ELEMENT_ARRAY_BUFFER)'")},
+        {"release",                ksf_wrap(T_release_, T_NAME ".release(self, buf, offset)", "Free the slice at 'offset' of 'buf', merging it with adjacent free space")},
+        {"defragment",             ksf_wrap(T_defragment_, T_NAME ".defragment(self)", "Move slices to the start of their buffers (on the GPU), so free space is contiguous (apart from gaps needed to keep offsets a multiple of their stride). Returns a list of '(buf, old_offset, new_offset, size)' for each slice that moved")},
+    ));
+}
@@ -0,0 +1,90 @@
+/* computeshader.c - gl.ComputeShader type
+ *
+ * @author: Cade Brown <cade@kscript.org>
+ */
+#include <ksgl.h>
+
+#define T_NAME M_NAME ".ComputeShader"
+
+
+/* Internals */
+
+/* C-API */
+
+/* Type Functions */
+
+static KS_TFUNC(T, init) {
+    ksgl_shader self;
+    ks_str src;
+    KS_ARGS("self:* src:*", &self, ksglt_computeshader, &src, kst_str);
+
+    self->val = -1;
+    self->prog = NULL;
+
+    if (!ksgl_version(4, 3)) {
+        KS_THROW(kst_Error, "Compute shaders require OpenGL v4.3 (see 'gl.glfw.context_version()')");
+        return NULL;
+    }
+
+    if (!ksgl_shader_init(self, src, NULL, true)) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, dispatch) {
+    ksgl_shader self;
+    ks_cint x, y = 1, z = 1;
+    KS_ARGS("self:* x:cint ?y:cint ?z:cint", &self, ksglt_computeshader, &x, &y, &z);
+
+    if (!ksgl_shader_ready(self)) {
+        return NULL;
+    }
+
+    glUseProgram(self->val);
+    glDispatchCompute(x, y, z);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, storage_binding) {
+    ksgl_shader self;
+    ks_str name;
+    ks_cint binding;
+    KS_ARGS("self:* name:* binding:cint", &self, ksglt_computeshader, &name, kst_str, &binding);
+
+    if (!ksgl_shader_ready(self)) {
+        return NULL;
+    }
+
+    GLuint idx = glGetProgramResourceIndex(self->val, GL_SHADER_STORAGE_BLOCK, name->data);
+    if (idx == GL_INVALID_INDEX) {
+        KS_THROW(kst_Error, "Unknown shader storage block %R", name);
+        return NULL;
+    }
+
+    glShaderStorageBlockBinding(self->val, idx, binding);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+
+/* Export */
+
+ks_type ksglt_computeshader;
+
+void _ksgl_computeshader() {
+    ksglt_computeshader = ks_type_new(T_NAME, ksglt_shader, sizeof(struct ksgl_shader_s), -1, "OpenGL compute shader (requires OpenGL v4.3)", KS_IKV(
+        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, src)", "")},
+
+        {"dispatch",               ksf_wrap(T_dispatch_, T_NAME ".dispatch(self, x, y=1, z=1)", "Use this shader, and launch 'x * y * z' work groups. Use 'gl.memory_barrier()' before reading the results")},
+        {"storage_binding",        ksf_wrap(T_storage_binding_, T_NAME ".storage_binding(self, name, binding)", "Set the shader storage block 'name' to read from the buffer bound to 'binding' (see 'gl.VBO.bind_storage()')")},
+    ));
+}
@@ -9,6 +9,133 @@
 
 /* Internals */
 
+/* Return the OpenGL index type matching 'dtype', or 0 if there is none
+ * Signed types have none, since negative indices must be checked for (see 'my_upload()')
+ */
+static int my_gltype(nx_dtype dtype) {
+    if (dtype == nxd_u8) {
+        return GL_UNSIGNED_BYTE;
+    } else if (dtype == nxd_u16) {
+        return GL_UNSIGNED_SHORT;
+    } else if (dtype == nxd_u32) {
+        return GL_UNSIGNED_INT;
+    }
+
+    return 0;
+}
+
+/* Return whether 'dtype' is an integer type, which are the only ones that can hold indices
+ */
+static bool my_isint(nx_dtype dtype) {
+    return dtype == nxd_u8 || dtype == nxd_u16 || dtype == nxd_u32 || dtype == nxd_u64
+        || dtype == nxd_s8 || dtype == nxd_s16 || dtype == nxd_s32 || dtype == nxd_s64;
+}
+
+/* Return the size (in bytes) of an OpenGL index type
+ */
+static int my_typesize(int type) {
+    return type == GL_UNSIGNED_BYTE ? 1 : (type == GL_UNSIGNED_SHORT ? 2 : 4);
+}
+
+/* Upload the indices of 'x'. If 'narrow' is true, they are stored with the smallest type (but not
+ *   smaller than 'mintype') that can hold the largest index
+ */
+static bool my_upload(ksgl_ebo self, nx_t x, int usage, bool narrow, int mintype) {
+    ks_size_t n = nx_szprod(x.rank, x.shape);
+    int type = my_gltype(x.dtype);
+
+    if (!my_isint(x.dtype)) {
+        KS_THROW(kst_TypeError, "Indices must be integers, but got dtype %R", x.dtype);
+        return false;
+    }
+
+    if (!narrow && type) {
+        /* Already the right type, so keep it (only packing strided indices, without widening them) */
+        void* data = x.data;
+        if (!ksgl_contig(x)) {
+            data = ks_malloc(x.dtype->size * (n > 0 ? n : 1));
+            if (!data) {
+                KS_THROW(kst_Error, "Failed to allocate data");
+                return false;
+            }
+            ksgl_pack(x, data);
+        }
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, self->val);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, n * x.dtype->size, data, usage);
+        if (data != x.data) ks_free(data);
+        self->itype = type;
+        self->num = n;
+        return ksgl_check();
+    }
+
+    /* Convert to 32-bit indices first */
+    nx_u32* idx = ks_malloc(sizeof(*idx) * (n > 0 ? n : 1));
+    if (!idx) {
+        KS_THROW(kst_Error, "Failed to allocate data");
+        return false;
+    }
+    if (type) {
+        /* Unsigned, so every value fits */
+        if (!nx_cast(x, nx_make(idx, nxd_u32, x.rank, x.shape, NULL))) {
+            ks_free(idx);
+            return false;
+        }
+    } else {
+        /* Go through 64-bit signed integers, so negative (or too large) indices are caught instead of wrapping */
+        nx_s64* tmp = ks_malloc(sizeof(*tmp) * (n > 0 ? n : 1));
+        if (!tmp) {
+            ks_free(idx);
+            KS_THROW(kst_Error, "Failed to allocate data");
+            return false;
+        }
+        if (!nx_cast(x, nx_make(tmp, nxd_s64, x.rank, x.shape, NULL))) {
+            ks_free(tmp);
+            ks_free(idx);
+            return false;
+        }
+
+        ks_size_t i;
+        for (i = 0; i < n; ++i) {
+            if (tmp[i] < 0 || tmp[i] > 0xFFFFFFFFLL) {
+                KS_THROW(kst_Error, "Index at position %i is negative, or too large for 32-bit indices", (int)i);
+                ks_free(tmp);
+                ks_free(idx);
+                return false;
+            }
+            idx[i] = tmp[i];
+        }
+        ks_free(tmp);
+    }
+
+    type = GL_UNSIGNED_INT;
+    if (narrow) {
+        nx_u32 mx = 0;
+        ks_size_t i;
+        for (i = 0; i < n; ++i) {
+            if (idx[i] > mx) mx = idx[i];
+        }
+
+        /* Pack in place, which is safe since each element is written at or before where it was read */
+        if (mx <= 0xFF && mintype == GL_UNSIGNED_BYTE) {
+            type = GL_UNSIGNED_BYTE;
+            for (i = 0; i < n; ++i) ((nx_u8*)idx)[i] = idx[i];
+        } else if (mx <= 0xFFFF && mintype != GL_UNSIGNED_INT) {
+            type = GL_UNSIGNED_SHORT;
+            for (i = 0; i < n; ++i) ((nx_u16*)idx)[i] = idx[i];
+        }
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, self->val);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, n * my_typesize(type), idx, usage);
+    ks_free(idx);
+    self->itype = type;
+    self->num = n;
+
+    return ksgl_check();
+}
+
+
 /* C-API */
 
 /* Type Functions */
@@ -17,7 +144,7 @@ static KS_TFUNC(T, free) {
     ksgl_ebo self;
     KS_ARGS("self:*", &self, ksglt_ebo);
 
-    if (self->val >= 0) glDeleteBuffers(1, (GLuint[]){ self->val });
+    if (self->val >= 0) ksgl_delete(KSGL_OBJ_BUFFER, self->val, true);
 
     KSO_DEL(self);
     return KSO_NONE;
@@ -26,37 +153,76 @@ static KS_TFUNC(T, free) {
 static KS_TFUNC(T, init) {
     ksgl_ebo self;
     kso data = KSO_NONE;
-    ks_cint usage = GL_STATIC_DRAW;
-    KS_ARGS("self:* ?data ?usage:cint", &self, ksglt_ebo, &data, &usage);
+    ks_cint usage = GL_STATIC_DRAW, min_type = GL_UNSIGNED_SHORT;
+    bool narrow = false;
+    KS_ARGS("self:* ?data ?usage:cint ?narrow:bool ?min_type:cint", &self, ksglt_ebo, &data, &usage, &narrow, &min_type);
 
     self->val = -1;
+    self->itype = GL_UNSIGNED_INT;
+    self->num = 0;
+
+    if (min_type != GL_UNSIGNED_BYTE && min_type != GL_UNSIGNED_SHORT && min_type != GL_UNSIGNED_INT) {
+        KS_THROW(kst_Error, "'min_type' must be 'gl.UNSIGNED_BYTE', 'gl.UNSIGNED_SHORT' or 'gl.UNSIGNED_INT'");
+        return NULL;
+    }
 
     /* Create buffer object */
-    GLuint t;
-    glGenBuffers(1, &t);
-    self->val = t;
+    self->val = ksgl_genbuffer();
     if (!ksgl_check()) {
         return NULL;
     }
 
-    /* Convert the data to its bytes equivalent */
-    ks_bytes data_bytes = kso_bytes(data);
-    if (!data_bytes) {
+    if (kso_issub(data->type, nxt_array) || kso_issub(data->type, nxt_view)) {
+        nx_t x;
+        kso ref = NULL;
+        if (!nx_get(data, NULL, &x, &ref)) {
+            return NULL;
+        }
+
+        bool ok = my_upload(self, x, usage, narrow, min_type);
+        KS_NDECREF(ref);
+        if (!ok) {
+            return NULL;
+        }
+
+        return KSO_NONE;
+    }
+
+    /* Raw bytes, which are assumed to be 32-bit indices */
+    struct ksgl_data bytes;
+    if (!ksgl_data_get(data, &bytes)) {
         return NULL;
     }
 
     /* Bind as the currently used buffer */
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, self->val);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, data_bytes->len_b, data_bytes->data, usage);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, bytes.len, bytes.data, usage);
+    self->num = bytes.len / 4;
 
     /* Done with the bytes */
-    KS_DECREF(data_bytes);
+    ksgl_data_done(&bytes);
     if (!ksgl_check()) {
         return NULL;
     }
 
     return KSO_NONE;
 }
+
+static KS_TFUNC(T, getattr) {
+    ksgl_ebo self;
+    ks_str attr;
+    KS_ARGS("self:* attr:*", &self, ksglt_ebo, &attr, kst_str);
+
+    if (ks_str_eq_c(attr, "type", 4)) {
+        return (kso)ks_int_new(self->itype);
+    } else if (ks_str_eq_c(attr, "num", 3)) {
+        return (kso)ks_int_new(self->num);
+    }
+
+    KS_THROW_ATTR(self, attr);
+    return NULL;
+}
+
 static KS_TFUNC(T, bind) {
     ksgl_ebo self;
     KS_ARGS("self:*", &self, ksglt_ebo);
@@ -81,6 +247,32 @@ static KS_TFUNC(T, unbind) {
     return KSO_NONE;
 }
 
+static KS_TFUNC(T, draw) {
+    ksgl_ebo self;
+    ks_cint mode = GL_TRIANGLES, num = -1, first = 0, basevertex = 0;
+    KS_ARGS("self:* ?mode:cint ?num:cint ?first:cint ?basevertex:cint", &self, ksglt_ebo, &mode, &num, &first, &basevertex);
+
+    if (num < 0) num = self->num - first;
+    if (first < 0 || num < 0 || first + num > self->num) {
+        KS_THROW(kst_IndexError, "Indices [%i, %i) are out of bounds for %i indices", (int)first, (int)(first + num), (int)self->num);
+        return NULL;
+    }
+
+    /* Binding attaches it to the current VAO */
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, self->val);
+    void* byteoffset = (void*)(first * (ks_cint)my_typesize(self->itype));
+    if (basevertex != 0) {
+        glDrawElementsBaseVertex(mode, num, self->itype, byteoffset, basevertex);
+    } else {
+        glDrawElements(mode, num, self->itype, byteoffset);
+    }
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
 
 /* Export */
 
@@ -89,10 +281,12 @@ ks_type ksglt_ebo;
 void _ksgl_ebo() {
     ksglt_ebo = ks_type_new(T_NAME, kst_object, sizeof(struct ksgl_ebo_s), -1, "OpenGL element buffer object (ebo)", KS_IKV(
         {"__free",                 ksf_wrap(T_free_, T_NAME ".__free(self)", "")},
-        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, data='', usage=gl.STATIC_DRAW)", "")},
+        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, data='', usage=gl.STATIC_DRAW, narrow=false, min_type=gl.UNSIGNED_SHORT)", "Create an element buffer from indices. Arrays of 'nx.uint8', 'nx.uint16' or 'nx.uint32' are stored with the same type, and other integer arrays are converted to 32-bit indices (which throws if any are negative). Non-integer arrays are rejected. If 'narrow' is true, indices are stored with the smallest type that holds the largest one, but no smaller than 'min_type' (since 8-bit indices are slow on some hardware)")},
+        {"__getattr",              ksf_wrap(T_getattr_, T_NAME ".__getattr(self, attr)", "")},
 
         {"bind",                   ksf_wrap(T_bind_, T_NAME ".bind(self)", "Bind this element buffer object as the current one")},
         {"unbind",                 ksf_wrap(T_unbind_, T_NAME ".unbind(self)", "Unbind this element buffer object")},
+        {"draw",                   ksf_wrap(T_draw_, T_NAME ".draw(self, mode=gl.TRIANGLES, num=-1, first=0, basevertex=0)", "Bind this element buffer object to the current VAO, and draw 'num' indices (default: the rest) starting at index 'first', using the type they are stored as ('.type')")},
     ));
 }
 
@@ -17,6 +17,21 @@ static KS_TFUNC(M, poll) {
     return KSO_NONE;
 }
 
+static KS_TFUNC(M, context_version) {
+    ks_cint major, minor;
+    KS_ARGS("major:cint minor:cint", &major, &minor);
+
+    if (major < 3 || (major == 3 && minor < 3)) {
+        KS_THROW(kst_Error, "OpenGL v%i.%i is not supported, the minimum is v3.3", (int)major, (int)minor);
+        return NULL;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+
+    return KSO_NONE;
+}
+
 
 /* Export */
 
@@ -30,9 +45,19 @@ ks_module _ksgl_glfw() {
 
     //glfwSetErrorCallback(glfw_errcb);
 
-    /* Request OpenGL 3.3 core */
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    /* Request OpenGL 3.3 core, unless a higher version is given (i.e. 'KSGL_GL_VERSION=4.3' for compute shaders) */
+    int major = 3, minor = 3;
+    const char* ver = getenv("KSGL_GL_VERSION");
+    if (ver && sscanf(ver, "%i.%i", &major, &minor) != 2) {
+        major = 3;
+        minor = 3;
+    }
+    if (major < 3 || (major == 3 && minor < 3)) {
+        major = 3;
+        minor = 3;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
    
     /* Reset time */
@@ -50,6 +75,7 @@ ks_module _ksgl_glfw() {
 
         /* Functions */
         {"poll",                   ksf_wrap(M_poll_, M_NAME ".poll()", "Polls all GLFW events")},
+        {"context_version",        ksf_wrap(M_context_version_, M_NAME ".context_version(major, minor)", "Request an OpenGL 'major.minor' core context for windows created afterwards (default: v3.3, or the 'KSGL_GL_VERSION' environment variable). Compute shaders require v4.3")},
 
 
     ));
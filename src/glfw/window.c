@@ -20,6 +20,8 @@ static KS_TFUNC(T, free) {
     KS_ARGS("self:*", &self, ksgl_glfwt_window);
 
     if (self->val) {
+        ksgl_delete_drop(self->val);
+        ksgl_shader_drop(self->val);
         glfwDestroyWindow(self->val);
     }
 
@@ -51,8 +53,11 @@ static KS_TFUNC(T, init) {
     }
 
 
-    /* Set current OpenGL context */
+    /* Set current OpenGL context, and read its version */
     glfwMakeContextCurrent(self->val);
+    if (!ksgl_version_update()) {
+        return NULL;
+    }
 
     /* 1=vsync, 0=as fast as possible */
     glfwSwapInterval(1);
@@ -122,6 +127,13 @@ static KS_TFUNC(T, swap) {
 
     glfwSwapBuffers(self->val);
 
+    /* End of the frame, which is a safe point to delete objects that were freed during it with this
+     *   window's context current (only if it still is, since names belong to a single context)
+     */
+    if (glfwGetCurrentContext() == self->val && !ksgl_delete_flush()) {
+        return NULL;
+    }
+
     return KSO_NONE;
 }
 
@@ -142,7 +154,7 @@ void _ksgl_glfw_window() {
     
         {"show",                   ksf_wrap(T_show_, T_NAME ".show(self)", "Shows the window, if it was hidden")},
         {"hide",                   ksf_wrap(T_hide_, T_NAME ".hide(self)", "Hides the window, if it was shown")},
-        {"swap",                   ksf_wrap(T_swap_, T_NAME ".swap(self)", "Swaps the window buffers")},
+        {"swap",                   ksf_wrap(T_swap_, T_NAME ".swap(self)", "Swaps the window buffers, and deletes OpenGL objects that were freed since the last swap (see 'gl.flush_deletes()')")},
     
     ));
 }
@@ -272,6 +272,90 @@ static KS_TFUNC(M, viewport) {
 }
 
 
+static KS_TFUNC(M, supports) {
+    ks_cint major, minor;
+    KS_ARGS("major:cint minor:cint", &major, &minor);
+
+    return KSO_BOOL(ksgl_version(major, minor));
+}
+
+static KS_TFUNC(M, memory_barrier) {
+    ks_cint bits = GL_ALL_BARRIER_BITS;
+    KS_ARGS("?bits:cint", &bits);
+
+    if (!ksgl_version(4, 2) && !ksgl_hasext("GL_ARB_shader_image_load_store")) {
+        KS_THROW(kst_Error, "Memory barriers require OpenGL v4.2");
+        return NULL;
+    }
+
+    glMemoryBarrier(bits);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(M, flush_deletes) {
+    KS_ARGS("");
+
+    if (!ksgl_delete_flush()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(M, name_pool) {
+    ks_cint size;
+    KS_ARGS("size:cint", &size);
+
+    ksgl_pool_setmax(size);
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(M, draw_elements_base_vertex) {
+    ks_cint mode, num, type, byteoffset = 0, basevertex = 0;
+    KS_ARGS("mode:cint num:cint type:cint ?byteoffset:cint ?basevertex:cint", &mode, &num, &type, &byteoffset, &basevertex);
+
+    glDrawElementsBaseVertex(mode, num, type, (void*)byteoffset, basevertex);
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(M, copy_buffer) {
+    ksgl_vbo src, dst;
+    ks_cint src_offset = 0, dst_offset = 0, size = -1;
+    KS_ARGS("src:* dst:* ?src_offset:cint ?dst_offset:cint ?size:cint", &src, ksglt_vbo, &dst, ksglt_vbo, &src_offset, &dst_offset, &size);
+
+    if (kso_issub(dst->type, ksglt_shadowvbo)) {
+        KS_THROW(kst_Error, "Cannot copy into '%T' objects, since it would bypass the mirror", dst);
+        return NULL;
+    }
+
+    if (size < 0) size = src->size - src_offset;
+    if (src_offset < 0 || size < 0 || src_offset + size > src->size) {
+        KS_THROW(kst_SizeError, "Range [%i, %i) is out of bounds for source buffer of %i bytes", (int)src_offset, (int)(src_offset + size), (int)src->size);
+        return NULL;
+    } else if (dst_offset < 0 || dst_offset + size > dst->size) {
+        KS_THROW(kst_SizeError, "Range [%i, %i) is out of bounds for destination buffer of %i bytes", (int)dst_offset, (int)(dst_offset + size), (int)dst->size);
+        return NULL;
+    } else if (src == dst && src_offset < dst_offset + size && dst_offset < src_offset + size) {
+        KS_THROW(kst_Error, "Source and destination ranges overlap");
+        return NULL;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, src->val);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, dst->val);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, src_offset, dst_offset, size);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
 static KS_TFUNC(M, polygon_mode) {
     ks_cint face, mode = GL_FILL;
     KS_ARGS("face:cint ?mode:cint", &face, &mode);
@@ -311,12 +395,10 @@ static ks_module get() {
     /* OpenGL initialization */
     
 
-    /* Initialize through gl3w */
+    /* Initialize through gl3w
+     * No context exists yet, so the version is checked when a window is created (see 'ksgl_version_update()')
+     */
     gl3wInit();
-    if (gl3wIsSupported(3, 3) != 0) {
-        KS_THROW(kst_Error, "Failed to initialize OpenGL v3.3");
-        return NULL;
-    }
 
 #ifdef KSGL_GLFW
     ks_module res_glfw = _ksgl_glfw();
@@ -345,10 +427,19 @@ static ks_module get() {
     }
 
     _ksgl_shader();
+    _ksgl_shaderlibrary();
+    _ksgl_computeshader();
+    _ksgl_uniform();
 
     _ksgl_texture2d();
 
     _ksgl_vbo();
+    _ksgl_ubo();
+    _ksgl_uniformring();
+    _ksgl_streambuffer();
+    _ksgl_readback();
+    _ksgl_bufferarena();
+    _ksgl_shadowvbo();
     _ksgl_ebo();
     _ksgl_vao();
 
@@ -367,11 +458,20 @@ static ks_module get() {
         
         /* Types */
         {"Shader",  (kso)ksglt_shader},
+        {"ShaderLibrary",  (kso)ksglt_shaderlibrary},
+        {"ComputeShader",  (kso)ksglt_computeshader},
+        {"Uniform",  (kso)ksglt_uniform},
 
         {"Texture2D",  (kso)ksglt_texture2d},
 
+        {"Readback",  (kso)ksglt_readback},
+        {"BufferArena",  (kso)ksglt_bufferarena},
+        {"ShadowVBO",  (kso)ksglt_shadowvbo},
         {"EBO",  (kso)ksglt_ebo},
         {"VBO",  (kso)ksglt_vbo},
+        {"UBO",  (kso)ksglt_ubo},
+        {"UniformRing",  (kso)ksglt_uniformring},
+        {"StreamBuffer",  (kso)ksglt_streambuffer},
         {"VAO",  (kso)ksglt_vao},
 
         /* Functions */
@@ -389,12 +489,20 @@ static ks_module get() {
         {"clear",                  ksf_wrap(M_clear_, M_NAME ".clear(flags)", "Clears 'flags' (which should be a bitmask of OpenGL flags)")},
         {"clear_color",            ksf_wrap(M_clearColor_, M_NAME ".clearColor(*args)", "Sets the clear color to '*args', which should be the RGBA components (default: black)")},
 
+        {"supports",               ksf_wrap(M_supports_, M_NAME ".supports(major, minor)", "Returns whether the current context supports OpenGL version 'major.minor'")},
+        {"memory_barrier",         ksf_wrap(M_memory_barrier_, M_NAME ".memory_barrier(bits=gl.ALL_BARRIER_BITS)", "Make writes from shaders (i.e. 'gl.ComputeShader.dispatch()') visible to the uses in 'bits' (i.e. 'gl.SHADER_STORAGE_BARRIER_BIT | gl.VERTEX_ATTRIB_ARRAY_BARRIER_BIT'). Requires OpenGL v4.2")},
+
         {"viewport",               ksf_wrap(M_viewport_, M_NAME ".viewport(x, y, w, h)", "Set the viewport rendering range")},
 
         {"polygon_mode",           ksf_wrap(M_polygon_mode_, M_NAME "polygon_mode(face, mode=gl.FILL)", "Set the polygon rendering mode")},
 
+        {"flush_deletes",          ksf_wrap(M_flush_deletes_, M_NAME ".flush_deletes()", "Delete OpenGL objects that were freed (by the garbage collector), which is deferred until a safe point. 'gl.glfw.Window.swap()' calls this, so it is only needed without it (i.e. at the end of each frame). Each context has its own queue, so this only deletes objects freed while the current one was current, and objects freed with no context current are leaked")},
+        {"name_pool",              ksf_wrap(M_name_pool_, M_NAME ".name_pool(size)", "Keep up to 'size' names of freed buffers (per context) to reuse for new ones, instead of deleting them and generating new names (default: 0, which disables pooling). A recycled name stays attached to any VAO that still references it, so such a VAO silently reads the new buffer's data, and must be set up again (or freed) along with its buffers")},
+        {"copy_buffer",            ksf_wrap(M_copy_buffer_, M_NAME ".copy_buffer(src, dst, src_offset=0, dst_offset=0, size=-1)", "Copy 'size' bytes (default: the rest of 'src') between buffers on the GPU")},
+
         {"draw_arrays",            ksf_wrap(M_draw_arrays_, M_NAME ".draw_arrays(mode, num, offset=0)", "Draws primitives from the currently bound vao")},
         {"draw_elements",           ksf_wrap(M_draw_elements_, M_NAME ".draw_elements(mode, num, type, byteoffset=0)", "Draws primitives from the currently bound VAO's EBO")},
+        {"draw_elements_base_vertex", ksf_wrap(M_draw_elements_base_vertex_, M_NAME ".draw_elements_base_vertex(mode, num, type, byteoffset=0, basevertex=0)", "Draws primitives from the currently bound VAO's EBO, adding 'basevertex' to each index. This lets meshes in slices of a 'gl.BufferArena' share one VAO and element buffer (with 'byteoffset' being the offset of the index slice, and 'basevertex' the offset of the vertex slice divided by the stride it was allocated with)")},
 
     ));
 
@@ -2867,6 +2975,129 @@ static ks_module get() {
   {"INT_2_10_10_10_RE", GL_INT_2_10_10_10_RE},
 #endif
 
+/* Buffer usage and mapping */
+#ifdef GL_STREAM_DRAW
+  {"STREAM_DRAW", GL_STREAM_DRAW},
+#endif
+#ifdef GL_STREAM_READ
+  {"STREAM_READ", GL_STREAM_READ},
+#endif
+#ifdef GL_STREAM_COPY
+  {"STREAM_COPY", GL_STREAM_COPY},
+#endif
+#ifdef GL_STATIC_DRAW
+  {"STATIC_DRAW", GL_STATIC_DRAW},
+#endif
+#ifdef GL_STATIC_READ
+  {"STATIC_READ", GL_STATIC_READ},
+#endif
+#ifdef GL_STATIC_COPY
+  {"STATIC_COPY", GL_STATIC_COPY},
+#endif
+#ifdef GL_DYNAMIC_DRAW
+  {"DYNAMIC_DRAW", GL_DYNAMIC_DRAW},
+#endif
+#ifdef GL_DYNAMIC_READ
+  {"DYNAMIC_READ", GL_DYNAMIC_READ},
+#endif
+#ifdef GL_DYNAMIC_COPY
+  {"DYNAMIC_COPY", GL_DYNAMIC_COPY},
+#endif
+#ifdef GL_MAP_READ_BIT
+  {"MAP_READ_BIT", GL_MAP_READ_BIT},
+#endif
+#ifdef GL_MAP_WRITE_BIT
+  {"MAP_WRITE_BIT", GL_MAP_WRITE_BIT},
+#endif
+#ifdef GL_MAP_INVALIDATE_RANGE_BIT
+  {"MAP_INVALIDATE_RANGE_BIT", GL_MAP_INVALIDATE_RANGE_BIT},
+#endif
+#ifdef GL_MAP_INVALIDATE_BUFFER_BIT
+  {"MAP_INVALIDATE_BUFFER_BIT", GL_MAP_INVALIDATE_BUFFER_BIT},
+#endif
+#ifdef GL_MAP_FLUSH_EXPLICIT_BIT
+  {"MAP_FLUSH_EXPLICIT_BIT", GL_MAP_FLUSH_EXPLICIT_BIT},
+#endif
+#ifdef GL_MAP_UNSYNCHRONIZED_BIT
+  {"MAP_UNSYNCHRONIZED_BIT", GL_MAP_UNSYNCHRONIZED_BIT},
+#endif
+#ifdef GL_MAP_PERSISTENT_BIT
+  {"MAP_PERSISTENT_BIT", GL_MAP_PERSISTENT_BIT},
+#endif
+#ifdef GL_MAP_COHERENT_BIT
+  {"MAP_COHERENT_BIT", GL_MAP_COHERENT_BIT},
+#endif
+
+/* Vertex attribute types (for 'gl.VAO.layout()') */
+#ifdef GL_HALF_FLOAT
+  {"HALF_FLOAT", GL_HALF_FLOAT},
+#endif
+#ifdef GL_DOUBLE
+  {"DOUBLE", GL_DOUBLE},
+#endif
+#ifdef GL_FIXED
+  {"FIXED", GL_FIXED},
+#endif
+#ifdef GL_INT_2_10_10_10_REV
+  {"INT_2_10_10_10_REV", GL_INT_2_10_10_10_REV},
+#endif
+#ifdef GL_UNSIGNED_INT_2_10_10_10_REV
+  {"UNSIGNED_INT_2_10_10_10_REV", GL_UNSIGNED_INT_2_10_10_10_REV},
+#endif
+#ifdef GL_UNSIGNED_INT_10F_11F_11F_REV
+  {"UNSIGNED_INT_10F_11F_11F_REV", GL_UNSIGNED_INT_10F_11F_11F_REV},
+#endif
+
+/* OpenGL v4.3 (compute shaders) */
+#ifdef GL_SHADER_STORAGE_BUFFER
+  {"SHADER_STORAGE_BUFFER", GL_SHADER_STORAGE_BUFFER},
+#endif
+#ifdef GL_DISPATCH_INDIRECT_BUFFER
+  {"DISPATCH_INDIRECT_BUFFER", GL_DISPATCH_INDIRECT_BUFFER},
+#endif
+#ifdef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+  {"VERTEX_ATTRIB_ARRAY_BARRIER_BIT", GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT},
+#endif
+#ifdef GL_ELEMENT_ARRAY_BARRIER_BIT
+  {"ELEMENT_ARRAY_BARRIER_BIT", GL_ELEMENT_ARRAY_BARRIER_BIT},
+#endif
+#ifdef GL_UNIFORM_BARRIER_BIT
+  {"UNIFORM_BARRIER_BIT", GL_UNIFORM_BARRIER_BIT},
+#endif
+#ifdef GL_TEXTURE_FETCH_BARRIER_BIT
+  {"TEXTURE_FETCH_BARRIER_BIT", GL_TEXTURE_FETCH_BARRIER_BIT},
+#endif
+#ifdef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+  {"SHADER_IMAGE_ACCESS_BARRIER_BIT", GL_SHADER_IMAGE_ACCESS_BARRIER_BIT},
+#endif
+#ifdef GL_COMMAND_BARRIER_BIT
+  {"COMMAND_BARRIER_BIT", GL_COMMAND_BARRIER_BIT},
+#endif
+#ifdef GL_PIXEL_BUFFER_BARRIER_BIT
+  {"PIXEL_BUFFER_BARRIER_BIT", GL_PIXEL_BUFFER_BARRIER_BIT},
+#endif
+#ifdef GL_TEXTURE_UPDATE_BARRIER_BIT
+  {"TEXTURE_UPDATE_BARRIER_BIT", GL_TEXTURE_UPDATE_BARRIER_BIT},
+#endif
+#ifdef GL_BUFFER_UPDATE_BARRIER_BIT
+  {"BUFFER_UPDATE_BARRIER_BIT", GL_BUFFER_UPDATE_BARRIER_BIT},
+#endif
+#ifdef GL_FRAMEBUFFER_BARRIER_BIT
+  {"FRAMEBUFFER_BARRIER_BIT", GL_FRAMEBUFFER_BARRIER_BIT},
+#endif
+#ifdef GL_TRANSFORM_FEEDBACK_BARRIER_BIT
+  {"TRANSFORM_FEEDBACK_BARRIER_BIT", GL_TRANSFORM_FEEDBACK_BARRIER_BIT},
+#endif
+#ifdef GL_ATOMIC_COUNTER_BARRIER_BIT
+  {"ATOMIC_COUNTER_BARRIER_BIT", GL_ATOMIC_COUNTER_BARRIER_BIT},
+#endif
+#ifdef GL_SHADER_STORAGE_BARRIER_BIT
+  {"SHADER_STORAGE_BARRIER_BIT", GL_SHADER_STORAGE_BARRIER_BIT},
+#endif
+#ifdef GL_ALL_BARRIER_BITS
+  {"ALL_BARRIER_BITS", GL_ALL_BARRIER_BITS},
+#endif
+
     ));
 
     ks_dict_merge(res->attr, E_gl->attr);
@@ -0,0 +1,163 @@
+/* readback.c - gl.Readback type
+ *
+ * @author: Cade Brown <cade@kscript.org>
+ */
+#include <ksgl.h>
+
+#define T_NAME M_NAME ".Readback"
+
+
+/* Internals */
+
+/* Wait for the copy to finish, and read the staging buffer into 'self->result'
+ */
+static bool my_finish(ksgl_readback self) {
+    if (self->result) {
+        return true;
+    }
+
+    if (!ksgl_fence_wait(&self->fence, NULL)) {
+        return false;
+    }
+
+    /* The copy is done, so mapping does not stall */
+    void* src = NULL;
+    if (self->size > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, self->val);
+        src = glMapBufferRange(GL_COPY_READ_BUFFER, 0, self->size, GL_MAP_READ_BIT);
+        if (!src) {
+            if (ksgl_check()) KS_THROW(kst_Error, "Failed to map staging buffer");
+            return false;
+        }
+    }
+
+    if (self->dtype) {
+        self->result = (kso)nx_array_newc(nxt_array, src, self->dtype, 1, (ks_size_t[]){ self->size / self->dtype->size }, NULL);
+    } else {
+        self->result = (kso)ks_bytes_new(self->size, src);
+    }
+
+    if (src) glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+    /* Staging buffer is no longer needed */
+    ksgl_delete(KSGL_OBJ_BUFFER, self->val, true);
+    self->val = -1;
+
+    return self->result != NULL && ksgl_check();
+}
+
+
+/* C-API */
+
+ksgl_readback ksgl_readback_new(int buf, ks_ssize_t offset, ks_ssize_t size, nx_dtype dtype) {
+    if (dtype && size % dtype->size != 0) {
+        KS_THROW(kst_SizeError, "Size (%i bytes) is not a multiple of the element size (%i bytes)", (int)size, (int)dtype->size);
+        return NULL;
+    }
+
+    ksgl_readback self = KSO_NEW(ksgl_readback, ksglt_readback);
+    self->val = -1;
+    self->size = size;
+    self->fence = NULL;
+    if (dtype) KS_INCREF(dtype);
+    self->dtype = dtype;
+    self->result = NULL;
+
+    /* Create the staging buffer, and copy on the GPU */
+    self->val = ksgl_genbuffer();
+    glBindBuffer(GL_COPY_WRITE_BUFFER, self->val);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_READ);
+    if (size > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buf);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, size);
+    }
+
+    /* Signaled once the copy (and everything before it) is done */
+    self->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (!ksgl_check()) {
+        KS_DECREF(self);
+        return NULL;
+    }
+
+    /* Make sure the fence is actually submitted, so polling 'ready()' eventually succeeds */
+    glFlush();
+
+    return self;
+}
+
+
+/* Type Functions */
+
+static KS_TFUNC(T, free) {
+    ksgl_readback self;
+    KS_ARGS("self:*", &self, ksglt_readback);
+
+    if (self->val >= 0) ksgl_delete(KSGL_OBJ_BUFFER, self->val, true);
+    ksgl_delete_sync(self->fence);
+    KS_NDECREF(self->dtype);
+    KS_NDECREF(self->result);
+
+    KSO_DEL(self);
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, init) {
+    ksgl_readback self;
+    KS_ARGS("self:*", &self, ksglt_readback);
+
+    KS_THROW(kst_TypeError, "'%T' cannot be created directly, use 'gl.VBO.read_async()'", self);
+    return NULL;
+}
+
+static KS_TFUNC(T, getattr) {
+    ksgl_readback self;
+    ks_str attr;
+    KS_ARGS("self:* attr:*", &self, ksglt_readback, &attr, kst_str);
+
+    if (ks_str_eq_c(attr, "size", 4)) {
+        return (kso)ks_int_new(self->size);
+    }
+
+    KS_THROW_ATTR(self, attr);
+    return NULL;
+}
+
+static KS_TFUNC(T, ready) {
+    ksgl_readback self;
+    KS_ARGS("self:*", &self, ksglt_readback);
+
+    if (self->result || !self->fence) {
+        return KSO_TRUE;
+    }
+
+    /* Poll, without blocking */
+    GLenum rc = glClientWaitSync(self->fence, 0, 0);
+    return KSO_BOOL(rc == GL_ALREADY_SIGNALED || rc == GL_CONDITION_SATISFIED);
+}
+
+static KS_TFUNC(T, result) {
+    ksgl_readback self;
+    KS_ARGS("self:*", &self, ksglt_readback);
+
+    if (!my_finish(self)) {
+        return NULL;
+    }
+
+    return KS_NEWREF(self->result);
+}
+
+
+/* Export */
+
+ks_type ksglt_readback;
+
+void _ksgl_readback() {
+    ksglt_readback = ks_type_new(T_NAME, kst_object, sizeof(struct ksgl_readback_s), -1, "Pending read of buffer contents, which completes without stalling the pipeline", KS_IKV(
+        {"__free",                 ksf_wrap(T_free_, T_NAME ".__free(self)", "")},
+        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self)", "")},
+        {"__getattr",              ksf_wrap(T_getattr_, T_NAME ".__getattr(self, attr)", "")},
+
+        {"ready",                  ksf_wrap(T_ready_, T_NAME ".ready(self)", "Returns whether the GPU has finished the copy, so 'result()' will not block")},
+        {"result",                 ksf_wrap(T_result_, T_NAME ".result(self)", "Return the contents (an 'nx' array if a 'dtype' was given, otherwise bytes), waiting for the copy to finish if needed")},
+    ));
+}
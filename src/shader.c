@@ -12,15 +12,664 @@
 /* Maximum size of information log */
 #define KSGL_INFOLOG_MAX 1024
 
+/* Maximum length of a uniform name */
+#define KSGL_UNIFORMNAME_MAX 256
+
+/* Magic header for program binaries in the cache */
+#define KSGL_CACHE_MAGIC "ksglpb02"
+
+
+/* Directory to cache program binaries in, or NULL if the cache is disabled */
+static ks_str my_cachedir = NULL;
+
+/* Number of programs loaded from the cache (hits), and compiled from source (misses) */
+static ks_cint my_cache_hits = 0, my_cache_misses = 0;
+
+/* Registry of linked programs, which are shared between shaders with the same sources */
+static int my_nprograms = 0, my_maxprograms = 0;
+static struct ksgl_program** my_programs = NULL;
+
+/* Whether 'KHR_parallel_shader_compile' is supported (or -1, if it has not been queried yet) */
+static int my_khrparallel = -1;
+
+/* Builds a shader from sources, and checks the status of an asynchronously built program (defined below) */
+static bool my_build(ksgl_shader self, ks_str src_vert, ks_str src_frag, bool wait);
+static bool my_finish(struct ksgl_program* prog);
+
+
+/* Hash a uniform name (FNV-1a) */
+static ks_hash_t my_hash(ks_size_t len, const char* data) {
+    ks_hash_t res = 14695981039346656037ULL;
+    ks_size_t i;
+    for (i = 0; i < len; ++i) {
+        res ^= (unsigned char)data[i];
+        res *= 1099511628211ULL;
+    }
+    return res;
+}
+
+
+/* Uniform setters, for each kind of uniform */
+#define SETV(_name, _func, _type) \
+static void set_##_name(int loc, int count, const void* data) { \
+    _func(loc, count, (const _type*)data); \
+}
+#define SETM(_name, _func) \
+static void set_##_name(int loc, int count, const void* data) { \
+    _func(loc, count, GL_TRUE, (const GLfloat*)data); \
+}
+
+SETV(1f, glUniform1fv, GLfloat)
+SETV(2f, glUniform2fv, GLfloat)
+SETV(3f, glUniform3fv, GLfloat)
+SETV(4f, glUniform4fv, GLfloat)
+SETV(1i, glUniform1iv, GLint)
+SETV(2i, glUniform2iv, GLint)
+SETV(3i, glUniform3iv, GLint)
+SETV(4i, glUniform4iv, GLint)
+SETV(1u, glUniform1uiv, GLuint)
+SETV(2u, glUniform2uiv, GLuint)
+SETV(3u, glUniform3uiv, GLuint)
+SETV(4u, glUniform4uiv, GLuint)
+SETM(m2, glUniformMatrix2fv)
+SETM(m2x3, glUniformMatrix2x3fv)
+SETM(m2x4, glUniformMatrix2x4fv)
+SETM(m3, glUniformMatrix3fv)
+SETM(m3x2, glUniformMatrix3x2fv)
+SETM(m3x4, glUniformMatrix3x4fv)
+SETM(m4, glUniformMatrix4fv)
+SETM(m4x2, glUniformMatrix4x2fv)
+SETM(m4x3, glUniformMatrix4x3fv)
+
+#undef SETV
+#undef SETM
+
+/* Fill in the element shape, kind and setter for a uniform type
+ * Returns false if the type is not supported (i.e. doubles), in which case 'set' is NULL
+ */
+static bool my_typeinfo(struct ksgl_shader_uniform* u) {
+    u->rows = 1;
+    u->set = NULL;
+    u->kind = 'f';
+
+    #define CASE(_type, _kind, _rows, _cols, _set) case _type: u->kind = _kind; u->rows = _rows; u->cols = _cols; u->set = set_##_set; break;
+    switch (u->type) {
+        CASE(GL_FLOAT,             'f', 1, 1, 1f)
+        CASE(GL_FLOAT_VEC2,        'f', 1, 2, 2f)
+        CASE(GL_FLOAT_VEC3,        'f', 1, 3, 3f)
+        CASE(GL_FLOAT_VEC4,        'f', 1, 4, 4f)
+        CASE(GL_INT,               'i', 1, 1, 1i)
+        CASE(GL_INT_VEC2,          'i', 1, 2, 2i)
+        CASE(GL_INT_VEC3,          'i', 1, 3, 3i)
+        CASE(GL_INT_VEC4,          'i', 1, 4, 4i)
+        CASE(GL_BOOL,              'i', 1, 1, 1i)
+        CASE(GL_BOOL_VEC2,         'i', 1, 2, 2i)
+        CASE(GL_BOOL_VEC3,         'i', 1, 3, 3i)
+        CASE(GL_BOOL_VEC4,         'i', 1, 4, 4i)
+        CASE(GL_UNSIGNED_INT,      'u', 1, 1, 1u)
+        CASE(GL_UNSIGNED_INT_VEC2, 'u', 1, 2, 2u)
+        CASE(GL_UNSIGNED_INT_VEC3, 'u', 1, 3, 3u)
+        CASE(GL_UNSIGNED_INT_VEC4, 'u', 1, 4, 4u)
+
+        /* 'matCxR' has 'C' columns and 'R' rows */
+        CASE(GL_FLOAT_MAT2,        'f', 2, 2, m2)
+        CASE(GL_FLOAT_MAT2x3,      'f', 3, 2, m2x3)
+        CASE(GL_FLOAT_MAT2x4,      'f', 4, 2, m2x4)
+        CASE(GL_FLOAT_MAT3,        'f', 3, 3, m3)
+        CASE(GL_FLOAT_MAT3x2,      'f', 2, 3, m3x2)
+        CASE(GL_FLOAT_MAT3x4,      'f', 4, 3, m3x4)
+        CASE(GL_FLOAT_MAT4,        'f', 4, 4, m4)
+        CASE(GL_FLOAT_MAT4x2,      'f', 2, 4, m4x2)
+        CASE(GL_FLOAT_MAT4x3,      'f', 3, 4, m4x3)
+
+        default:
+            /* Samplers and images are set by their texture unit */
+            u->kind = 'i';
+            u->cols = 1;
+            u->set = set_1i;
+            break;
+
+        /* Double precision is not supported */
+        case GL_DOUBLE:
+        case GL_DOUBLE_VEC2:
+        case GL_DOUBLE_VEC3:
+        case GL_DOUBLE_VEC4:
+        case GL_DOUBLE_MAT2:
+        case GL_DOUBLE_MAT2x3:
+        case GL_DOUBLE_MAT2x4:
+        case GL_DOUBLE_MAT3:
+        case GL_DOUBLE_MAT3x2:
+        case GL_DOUBLE_MAT3x4:
+        case GL_DOUBLE_MAT4:
+        case GL_DOUBLE_MAT4x2:
+        case GL_DOUBLE_MAT4x3:
+            u->cols = 1;
+            break;
+    }
+    #undef CASE
+
+    u->elsize = 4 * u->rows * u->cols;
+    return u->set != NULL;
+}
+
+/* Read the current value of the uniform element at 'loc' into 'out', in packed format
+ */
+static void my_readuniform(struct ksgl_program* prog, struct ksgl_shader_uniform* u, int loc, unsigned char* out) {
+    GLfloat v[16];
+    if (u->kind == 'i') {
+        glGetUniformiv(prog->val, loc, (GLint*)out);
+    } else if (u->kind == 'u') {
+        glGetUniformuiv(prog->val, loc, (GLuint*)out);
+    } else if (u->rows == 1) {
+        glGetUniformfv(prog->val, loc, (GLfloat*)out);
+    } else {
+        /* Matrices are returned column-major, so transpose them */
+        glGetUniformfv(prog->val, loc, v);
+        int i, j;
+        for (i = 0; i < u->rows; ++i) {
+            for (j = 0; j < u->cols; ++j) {
+                ((GLfloat*)out)[i * u->cols + j] = v[j * u->rows + i];
+            }
+        }
+    }
+}
+
+/* Add an entry to the uniform table, which takes a reference to 'name'
+ * Assumes the table has already been sized
+ */
+static struct ksgl_shader_uniform* my_adduniform(struct ksgl_program* prog, ks_str name, int loc, int type, int size, int offset) {
+    int idx = prog->n_uniforms++;
+    prog->uniforms[idx].name = name;
+    prog->uniforms[idx].loc = loc;
+    prog->uniforms[idx].type = type;
+    prog->uniforms[idx].size = size;
+    prog->uniforms[idx].offset = offset;
+    prog->uniforms[idx].index = -1;
+    prog->uniforms[idx].elem = -1;
+    prog->uniforms[idx].block = -1;
+    my_typeinfo(&prog->uniforms[idx]);
+
+    /* Linear probe for an empty bucket */
+    int mask = prog->n_buckets - 1;
+    int b = my_hash(name->len_b, name->data) & mask;
+    while (prog->buckets[b] >= 0) {
+        b = (b + 1) & mask;
+    }
+    prog->buckets[b] = idx;
+
+    return &prog->uniforms[idx];
+}
+
+/* Clear the uniform table */
+static void my_clearuniforms(struct ksgl_program* prog) {
+    int i;
+    for (i = 0; i < prog->n_uniforms; ++i) {
+        KS_DECREF(prog->uniforms[i].name);
+    }
+    for (i = 0; i < prog->n_blocks; ++i) {
+        KS_DECREF(prog->blocks[i].name);
+    }
+    ks_free(prog->uniforms);
+    ks_free(prog->buckets);
+    ks_free(prog->shadow);
+    ks_free(prog->blocks);
+    KS_NDECREF(prog->refl_uniforms);
+    KS_NDECREF(prog->refl_attributes);
+    KS_NDECREF(prog->refl_blocks);
+
+    prog->n_uniforms = 0;
+    prog->uniforms = NULL;
+    prog->n_buckets = 0;
+    prog->buckets = NULL;
+    prog->n_shadow = 0;
+    prog->shadow = NULL;
+    prog->n_blocks = 0;
+    prog->blocks = NULL;
+    prog->refl_uniforms = prog->refl_attributes = prog->refl_blocks = NULL;
+}
+
+/* Add 'name: (a, b, c)' to a reflection dict, stripping a trailing '[0]' from array names
+ */
+static void my_refladd(ks_dict d, const char* name, int len, int a, int b, int c) {
+    if (len > 3 && strcmp(name + len - 3, "[0]") == 0) len -= 3;
+
+    ks_str k = ks_str_new(len, name);
+    ks_tuple v = ks_tuple_newn(3, (kso[]) {
+        (kso)ks_int_new(a),
+        (kso)ks_int_new(b),
+        (kso)ks_int_new(c)
+    });
+    ks_dict_set(d, (kso)k, (kso)v);
+    KS_DECREF(k);
+    KS_DECREF(v);
+}
+
+/* Return a copy of a reflection dict, since the original is shared by every shader using the program
+ */
+static kso my_reflcopy(ks_dict refl) {
+    ks_dict res = ks_dict_new(NULL);
+    if (!ks_dict_merge(res, refl)) {
+        KS_DECREF(res);
+        return NULL;
+    }
+
+    return (kso)res;
+}
+
+/* Returns whether the name of an active uniform refers to an array (i.e. ends with '[0]')
+ */
+static bool my_isarray(const char* name, int len) {
+    return len > 3 && strcmp(name + len - 3, "[0]") == 0;
+}
+
+/* Enumerate all active uniforms of the linked program, and fill the uniform table
+ * Arrays are added under their base name ('arr'), as well as each element ('arr[0]', 'arr[1]', ...)
+ * The shadow state is initialized from the current (default) values in the program
+ * Also fills the reflection dicts for uniforms, attributes and blocks
+ */
+static bool my_reflect(struct ksgl_program* prog) {
+    my_clearuniforms(prog);
+
+    GLint nactive = 0, nblocks = 0, nattrs = 0;
+    glGetProgramiv(prog->val, GL_ACTIVE_UNIFORMS, &nactive);
+    glGetProgramiv(prog->val, GL_ACTIVE_UNIFORM_BLOCKS, &nblocks);
+    glGetProgramiv(prog->val, GL_ACTIVE_ATTRIBUTES, &nattrs);
+    if (!ksgl_check()) {
+        return false;
+    }
+
+    /* First pass: count the total number of entries, and the size of the shadow state */
+    char name[KSGL_UNIFORMNAME_MAX];
+    GLsizei len;
+    GLint size;
+    GLenum type;
+    int i, j, nent = 0;
+    for (i = 0; i < nactive; ++i) {
+        glGetActiveUniform(prog->val, i, sizeof(name), &len, &size, &type, name);
+
+        /* Same test as the second pass, since 'float a[1]' (or an array with only element 0 active) has
+         *   a size of 1, but still gets an entry for its base name and each element
+         */
+        nent += my_isarray(name, len) ? size + 1 : 1;
+
+        struct ksgl_shader_uniform t;
+        t.type = type;
+        my_typeinfo(&t);
+        prog->n_shadow += t.elsize * size;
+    }
+
+    /* Keep the load factor at most 1/2 */
+    prog->n_buckets = 8;
+    while (prog->n_buckets < 2 * nent) prog->n_buckets *= 2;
+
+    prog->uniforms = ks_malloc(sizeof(*prog->uniforms) * (nent + 1));
+    prog->buckets = ks_malloc(sizeof(*prog->buckets) * prog->n_buckets);
+    prog->shadow = ks_malloc(prog->n_shadow + 1);
+    prog->blocks = ks_malloc(sizeof(*prog->blocks) * (nblocks + 1));
+    if (!prog->uniforms || !prog->buckets || !prog->shadow || !prog->blocks) {
+        my_clearuniforms(prog);
+        KS_THROW(kst_Error, "Failed to allocate uniform table");
+        return false;
+    }
+    for (i = 0; i < prog->n_buckets; ++i) {
+        prog->buckets[i] = -1;
+    }
+
+    prog->refl_uniforms = ks_dict_new(NULL);
+    prog->refl_attributes = ks_dict_new(NULL);
+    prog->refl_blocks = ks_dict_new(NULL);
+
+    /* Vertex attributes */
+    for (i = 0; i < nattrs; ++i) {
+        glGetActiveAttrib(prog->val, i, sizeof(name), &len, &size, &type, name);
+        my_refladd(prog->refl_attributes, name, len, glGetAttribLocation(prog->val, name), type, size);
+    }
+
+    /* Uniform blocks */
+    for (i = 0; i < nblocks; ++i) {
+        struct ksgl_shader_block* b = &prog->blocks[prog->n_blocks++];
+        glGetActiveUniformBlockName(prog->val, i, sizeof(name), &len, name);
+        b->name = ks_str_new(len, name);
+        b->index = i;
+        glGetActiveUniformBlockiv(prog->val, i, GL_UNIFORM_BLOCK_BINDING, &b->binding);
+        glGetActiveUniformBlockiv(prog->val, i, GL_UNIFORM_BLOCK_DATA_SIZE, &b->size);
+
+        GLint nmembers = 0;
+        glGetActiveUniformBlockiv(prog->val, i, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &nmembers);
+        my_refladd(prog->refl_blocks, name, len, i, b->size, nmembers);
+    }
+
+    /* Second pass: query locations and fill the table */
+    int offset = 0;
+    for (i = 0; i < nactive; ++i) {
+        glGetActiveUniform(prog->val, i, sizeof(name), &len, &size, &type, name);
+
+        /* Uniform block members have no location */
+        int loc = glGetUniformLocation(prog->val, name);
+        struct ksgl_shader_uniform* u;
+        GLint block = -1;
+        glGetActiveUniformsiv(prog->val, 1, (GLuint[]){ i }, GL_UNIFORM_BLOCK_INDEX, &block);
+        my_refladd(prog->refl_uniforms, name, len, loc, type, size);
+
+        bool arr = my_isarray(name, len);
+        if (prog->n_uniforms + (arr ? size + 1 : 1) > nent) {
+            KS_THROW(kst_Error, "Uniform table overflow at %s (the driver reported it differently between queries)", name);
+            return false;
+        }
+
+        if (arr) {
+            /* Array, so add the base name, and then each element (which share the shadow state) */
+            int blen = len - 3;
+            u = my_adduniform(prog, ks_str_new(blen, name), loc, type, size, offset);
+            u->index = i;
+            u->block = block;
+
+            for (j = 0; j < size; ++j) {
+                char ename[KSGL_UNIFORMNAME_MAX + 16];
+                int elen = snprintf(ename, sizeof(ename), "%.*s[%i]", blen, name, j);
+                int eloc = (j == 0 || loc < 0) ? loc : glGetUniformLocation(prog->val, ename);
+                struct ksgl_shader_uniform* e = my_adduniform(prog, ks_str_new(elen, ename), eloc, type, size - j, offset + j * u->elsize);
+                e->index = i;
+                e->elem = j;
+                e->block = block;
+                if (eloc >= 0 && u->set) my_readuniform(prog, u, eloc, prog->shadow + offset + j * u->elsize);
+            }
+        } else {
+            u = my_adduniform(prog, ks_str_new(len, name), loc, type, size, offset);
+            u->index = i;
+            u->block = block;
+            if (loc >= 0 && u->set) my_readuniform(prog, u, loc, prog->shadow + offset);
+        }
+
+        offset += u->elsize * size;
+    }
+
+    return ksgl_check();
+}
+
+/* Hash the sources of a program */
+static ks_hash_t my_srckey(ks_str src_vert, ks_str src_frag) {
+    ks_hash_t res = my_hash(src_vert->len_b, src_vert->data);
+    return src_frag ? res * 31 + my_hash(src_frag->len_b, src_frag->data) : res * 31 + 1;
+}
+
+/* Find a registered program built from the given sources in the current context, or return NULL */
+static struct ksgl_program* my_findprogram(ks_hash_t key, ks_str src_vert, ks_str src_frag) {
+    void* ctx = ksgl_context();
+    int i;
+    for (i = 0; i < my_nprograms; ++i) {
+        struct ksgl_program* p = my_programs[i];
+        if (p->key != key || p->ctx != ctx || (p->src_frag == NULL) != (src_frag == NULL)) continue;
+
+        if (p->src_vert->len_b == src_vert->len_b && memcmp(p->src_vert->data, src_vert->data, src_vert->len_b) == 0
+            && (!src_frag || (p->src_frag->len_b == src_frag->len_b && memcmp(p->src_frag->data, src_frag->data, src_frag->len_b) == 0))) {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+/* Create a new program (which is not yet registered) with a single reference */
+static struct ksgl_program* my_newprogram(ks_hash_t key, ks_str src_vert, ks_str src_frag) {
+    struct ksgl_program* prog = ks_malloc(sizeof(*prog));
+    if (!prog) {
+        KS_THROW(kst_Error, "Failed to allocate program");
+        return NULL;
+    }
+
+    prog->refs = 1;
+    prog->key = key;
+    KS_INCREF(src_vert);
+    prog->src_vert = src_vert;
+    if (src_frag) KS_INCREF(src_frag);
+    prog->src_frag = src_frag;
+    prog->ctx = ksgl_context();
+    prog->val = -1;
+    prog->sh_vert = prog->sh_frag = -1;
+    prog->pending = prog->failed = false;
+    prog->n_uniforms = 0;
+    prog->uniforms = NULL;
+    prog->n_buckets = 0;
+    prog->buckets = NULL;
+    prog->n_shadow = 0;
+    prog->shadow = NULL;
+    prog->n_blocks = 0;
+    prog->blocks = NULL;
+    prog->refl_uniforms = prog->refl_attributes = prog->refl_blocks = NULL;
+
+    return prog;
+}
+
+/* Add a program to the registry */
+static bool my_addprogram(struct ksgl_program* prog) {
+    if (my_nprograms >= my_maxprograms) {
+        int nmax = my_maxprograms * 2 + 8;
+        struct ksgl_program** np = ks_realloc(my_programs, sizeof(*my_programs) * nmax);
+        if (!np) {
+            KS_THROW(kst_Error, "Failed to allocate program registry");
+            return false;
+        }
+        my_programs = np;
+        my_maxprograms = nmax;
+    }
+
+    my_programs[my_nprograms++] = prog;
+    return true;
+}
+
+/* Remove a program from the registry (if it is registered), so it is never shared again */
+static void my_delprogram(struct ksgl_program* prog) {
+    int i;
+    for (i = 0; i < my_nprograms; ++i) {
+        if (my_programs[i] == prog) {
+            my_programs[i] = my_programs[--my_nprograms];
+            break;
+        }
+    }
+}
+
+/* Release a reference to a program, deleting it (and removing it from the registry) if it was the last one */
+static void my_releaseprogram(struct ksgl_program* prog) {
+    if (--prog->refs > 0) return;
+
+    my_delprogram(prog);
+
+    /* This may be called from the garbage collector, so defer deletion to a safe point */
+    if (prog->sh_vert >= 0) ksgl_delete(KSGL_OBJ_SHADER, prog->sh_vert, false);
+    if (prog->sh_frag >= 0) ksgl_delete(KSGL_OBJ_SHADER, prog->sh_frag, false);
+    if (prog->val >= 0) ksgl_delete(KSGL_OBJ_PROGRAM, prog->val, false);
+    my_clearuniforms(prog);
+    KS_DECREF(prog->src_vert);
+    KS_NDECREF(prog->src_frag);
+    ks_free(prog);
+}
+
+
 /* C-API */
 
+void ksgl_shader_drop(void* ctx) {
+    int i = 0;
+    while (i < my_nprograms) {
+        struct ksgl_program* p = my_programs[i];
+        if (p->ctx != ctx) {
+            i++;
+            continue;
+        }
+
+        /* Its objects are deleted with the context, so they must not be queued later (their names
+         *   may be reused by another context) */
+        p->val = p->sh_vert = p->sh_frag = -1;
+        if (p->pending) {
+            /* It will never finish building */
+            p->pending = false;
+            p->failed = true;
+        }
+        my_programs[i] = my_programs[--my_nprograms];
+    }
+}
+
+bool ksgl_shader_upload(ksgl_shader self, struct ksgl_shader_uniform* u, kso val) {
+    int n = u->rows * u->cols;
+
+    if (u->kind != 'f' && kso_is_int(val) && n == 1) {
+        /* Single integer */
+        ks_cint cv;
+        if (!kso_get_ci(val, &cv)) {
+            return false;
+        }
+
+        GLint v = cv;
+        ksgl_shader_setuniform(self, u, 1, &v);
+        return true;
+    }
+
+    nx_t vn;
+    kso ref = NULL;
+    if (!nx_get(val, u->kind == 'f' ? nxd_F : (u->kind == 'u' ? nxd_u32 : nxd_s32), &vn, &ref)) {
+        return false;
+    }
+
+    /* Whether an array of elements was given, i.e. '(N, 4, 4)' for 'mat4[]', or '(N, 3)' for 'vec3[]' */
+    int elrank = u->rows > 1 ? 2 : (u->cols > 1 ? 1 : 0);
+    bool isarr = u->size > 1 && vn.rank == elrank + 1;
+    if (isarr && elrank >= 1) isarr = vn.shape[vn.rank - 1] == u->cols;
+    if (isarr && elrank >= 2) isarr = vn.shape[1] == u->rows;
+
+    /* Check the shape of the value, and the number of elements being set */
+    int count = 1;
+    if (isarr) {
+        count = vn.shape[0];
+        if (count > u->size) {
+            KS_THROW(kst_SizeError, "Uniform %R only has %i elements, but %i were given", u->name, u->size, count);
+            KS_NDECREF(ref);
+            return false;
+        }
+    } else if (u->rows > 1) {
+        if (vn.rank != 2 || vn.shape[0] != u->rows || vn.shape[1] != u->cols) {
+            KS_THROW(kst_SizeError, "Expected array of shape (%i, %i) for uniform %R", u->rows, u->cols, u->name);
+            KS_NDECREF(ref);
+            return false;
+        }
+    } else {
+        if (nx_szprod(vn.rank, vn.shape) != n) {
+            KS_THROW(kst_SizeError, "Expected %i values for uniform %R", n, u->name);
+            KS_NDECREF(ref);
+            return false;
+        }
+    }
+
+    if (count == 0) {
+        /* Nothing to set */
+        KS_NDECREF(ref);
+        return true;
+    }
+
+    if (ksgl_contig(vn)) {
+        /* Already dense and row-major, so upload directly from the array's data */
+        ksgl_shader_setuniform(self, u, count, vn.data);
+        KS_NDECREF(ref);
+        return true;
+    }
+
+    /* Copy into 'v', as a dense array (all supported element types are 4 bytes) */
+    uint32_t vs[16];
+    uint32_t* v = vs;
+    if (count * n > 16) {
+        v = ks_malloc(sizeof(*v) * count * n);
+        if (!v) {
+            KS_THROW(kst_Error, "Failed to allocate data");
+            KS_NDECREF(ref);
+            return false;
+        }
+    }
+
+    ksgl_pack(vn, v);
+
+    ksgl_shader_setuniform(self, u, count, v);
+    if (v != vs) ks_free(v);
+    KS_NDECREF(ref);
+    return true;
+}
+
+void ksgl_shader_setuniform(ksgl_shader self, struct ksgl_shader_uniform* u, int count, const void* data) {
+    unsigned char* sh = self->prog->shadow + u->offset;
+    int nb = count * u->elsize;
+
+    if (memcmp(sh, data, nb) == 0) {
+        /* Already uploaded */
+        self->n_hits++;
+        return;
+    }
+
+    memcpy(sh, data, nb);
+    self->n_misses++;
+
+    /* The shadow belongs to this program, so the upload must go to it (and not whichever program is in use) */
+    GLint cur = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &cur);
+    if (cur != self->prog->val) {
+        glUseProgram(self->prog->val);
+        u->set(u->loc, count, data);
+        glUseProgram(cur);
+    } else {
+        u->set(u->loc, count, data);
+    }
+}
+
+ksgl_shader ksgl_shader_new(ks_str src_vert, ks_str src_frag, bool wait) {
+    ksgl_shader self = KSO_NEW(ksgl_shader, ksglt_shader);
+    if (!my_build(self, src_vert, src_frag, wait)) {
+        KS_DECREF(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+bool ksgl_shader_init(ksgl_shader self, ks_str src_vert, ks_str src_frag, bool wait) {
+    return my_build(self, src_vert, src_frag, wait);
+}
+
+bool ksgl_shader_ready(ksgl_shader self) {
+    return my_finish(self->prog);
+}
+
+struct ksgl_shader_block* ksgl_shader_getblock(ksgl_shader self, ks_str name) {
+    int i;
+    for (i = 0; i < self->prog->n_blocks; ++i) {
+        if (self->prog->blocks[i].name->len_b == name->len_b && memcmp(self->prog->blocks[i].name->data, name->data, name->len_b) == 0) {
+            return &self->prog->blocks[i];
+        }
+    }
+
+    return NULL;
+}
+
+struct ksgl_shader_uniform* ksgl_shader_getuniform(ksgl_shader self, ks_str name) {
+    if (self->prog->n_buckets == 0) return NULL;
+
+    int mask = self->prog->n_buckets - 1;
+    int b = my_hash(name->len_b, name->data) & mask;
+    while (self->prog->buckets[b] >= 0) {
+        struct ksgl_shader_uniform* u = &self->prog->uniforms[self->prog->buckets[b]];
+        if (u->name->len_b == name->len_b && memcmp(u->name->data, name->data, name->len_b) == 0) {
+            return u;
+        }
+        b = (b + 1) & mask;
+    }
+
+    return NULL;
+}
+
+
 /* Type Functions */
 
 static KS_TFUNC(T, free) {
     ksgl_shader self;
     KS_ARGS("self:*", &self, ksglt_shader);
 
-    if (self->val >= 0) glDeleteProgram(self->val);
+    if (self->prog) my_releaseprogram(self->prog);
 
     KSO_DEL(self);
     return KSO_NONE;
@@ -30,6 +679,7 @@ static KS_TFUNC(T, free) {
 
 /* Internal compilation, which takes a kind (GL_VERTEX_SHADER, etc),
  *   source
+ * The compile status is not checked (see 'check_shader()'), so the driver may compile in the background
  */
 static int compile_shader(int kind, ks_str src) {
     /* Create shader */
@@ -43,7 +693,12 @@ static int compile_shader(int kind, ks_str src) {
         return -1;
     }
 
-    /* Check success status */
+    return sh;
+}
+
+/* Check the compile status of a shader, and throw the information log if it failed
+ */
+static bool check_shader(int kind, int sh) {
     int success;
     glGetShaderiv(sh, GL_COMPILE_STATUS, &success);
     if (!success) {
@@ -51,19 +706,17 @@ static int compile_shader(int kind, ks_str src) {
         char infolog[KSGL_INFOLOG_MAX];
         glGetShaderInfoLog(sh, KSGL_INFOLOG_MAX, NULL, infolog);
 
-        /* Delete the shader */
-        glDeleteShader(sh);
-
         /* Throw */
-        KS_THROW(kst_Error, "Compiling '%s' shader failed: %s", kind == GL_VERTEX_SHADER ? "vertex" : (kind == GL_FRAGMENT_SHADER ? "fragment" : "unknown"), infolog);
-        return -1;
+        KS_THROW(kst_Error, "Compiling '%s' shader failed: %s", kind == GL_VERTEX_SHADER ? "vertex" : (kind == GL_FRAGMENT_SHADER ? "fragment" : (kind == GL_COMPUTE_SHADER ? "compute" : "unknown")), infolog);
+        return false;
     }
 
-    return sh;
+    return true;
 }
 
 
 /* Internal program maker, from a list of shaders
+ * The link status is not checked (see 'check_program()')
  */
 static int make_program(int nshaders, int* shaders) {
     /* Create complete shader program */
@@ -73,6 +726,11 @@ static int make_program(int nshaders, int* shaders) {
         return -1;
     }
 
+    if (my_cachedir && glProgramParameteri) {
+        /* Ask for a binary we can store in the cache */
+        glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
     /* Attach all prts */
     int i;
     for (i = 0; i < nshaders; ++i) {
@@ -89,7 +747,12 @@ static int make_program(int nshaders, int* shaders) {
         return -1;
     }
 
-    /* Check status */
+    return prog;
+}
+
+/* Check the link status of a program, and throw the information log if it failed
+ */
+static bool check_program(int prog) {
     int success;
     glGetProgramiv(prog, GL_LINK_STATUS, &success);
     if (!success) {
@@ -97,47 +760,355 @@ static int make_program(int nshaders, int* shaders) {
         char infolog[KSGL_INFOLOG_MAX];
         glGetProgramInfoLog(prog, KSGL_INFOLOG_MAX, NULL, infolog);
 
-        /* Delete program */
-        glDeleteProgram(prog);
-
         /* Throw */
         KS_THROW(kst_Error, "Linking shader failed: %s", infolog);
+        return false;
+    }
+
+    return true;
+}
+
+/* Append 'len' bytes of 'data' to a growing buffer, returning whether it succeeded */
+static bool my_append(char** buf, ks_size_t* n, const char* data, ks_size_t len) {
+    char* p = ks_realloc(*buf, *n + len + 1);
+    if (!p) return false;
+    memcpy(p + *n, data, len);
+    p[*n + len] = '\0';
+    *n += len + 1;
+    *buf = p;
+    return true;
+}
+
+/* Compute the identity of a program in the cache, which is the driver (renderer and version) and the full
+ *   sources, each followed by a NUL. It is stored in each entry, and compared when loading, so neither hash
+ *   collisions nor stale entries can load the wrong binary. Returns NULL if it could not be allocated
+ */
+static char* my_cacheid(struct ksgl_program* prog, ks_size_t* len) {
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+    if (!renderer) renderer = "";
+    if (!version) version = "";
+
+    char* res = NULL;
+    *len = 0;
+    if (!my_append(&res, len, renderer, strlen(renderer)) || !my_append(&res, len, version, strlen(version))
+        || !my_append(&res, len, prog->src_frag ? "render" : "compute", prog->src_frag ? 6 : 7)
+        || !my_append(&res, len, prog->src_vert->data, prog->src_vert->len_b)
+        || (prog->src_frag && !my_append(&res, len, prog->src_frag->data, prog->src_frag->len_b))) {
+        ks_free(res);
+        return NULL;
+    }
+
+    return res;
+}
+
+/* Get the path of a cache entry, which is named after the hash of its identity */
+static void my_cachepath(const char* id, ks_size_t idlen, char* out, int len) {
+    snprintf(out, len, "%s/%016llx.bin", my_cachedir->data, (unsigned long long)my_hash(idlen, id));
+}
+
+/* Attempt to load a program from the cache, returning -1 if it was not found, it was for different sources
+ *   or a different driver, or the driver rejected it
+ * Never throws an error
+ */
+static int my_cacheload(struct ksgl_program* p) {
+    if (!glProgramBinary) return -1;
+
+    ks_size_t idlen;
+    char* id = my_cacheid(p, &idlen);
+    if (!id) return -1;
+
+    char path[4096];
+    my_cachepath(id, idlen, path, sizeof(path));
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        ks_free(id);
+        return -1;
+    }
+
+    /* Read header: magic, identity length, identity, format, length */
+    char magic[8];
+    GLint flen;
+    GLenum fmt;
+    GLint len;
+    char* fid = NULL;
+    bool ok = fread(magic, 1, 8, fp) == 8 && memcmp(magic, KSGL_CACHE_MAGIC, 8) == 0 && fread(&flen, sizeof(flen), 1, fp) == 1 && flen == idlen
+        && (fid = ks_malloc(idlen)) != NULL && fread(fid, 1, idlen, fp) == idlen && memcmp(fid, id, idlen) == 0
+        && fread(&fmt, sizeof(fmt), 1, fp) == 1 && fread(&len, sizeof(len), 1, fp) == 1 && len > 0;
+    ks_free(fid);
+    ks_free(id);
+    if (!ok) {
+        fclose(fp);
+        return -1;
+    }
+
+    void* data = ks_malloc(len);
+    if (!data) {
+        fclose(fp);
+        return -1;
+    }
+    if (fread(data, 1, len, fp) != len) {
+        ks_free(data);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    int prog = glCreateProgram();
+    glProgramBinary(prog, fmt, data, len);
+    ks_free(data);
+
+    /* Drivers may reject binaries (i.e. after an update) */
+    int success = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &success);
+    if (glGetError() != GL_NO_ERROR || !success) {
+        glDeleteProgram(prog);
         return -1;
     }
 
     return prog;
 }
 
+/* Store a linked program in the cache
+ * Never throws an error, since the cache is only an optimization
+ */
+static void my_cachestore(struct ksgl_program* p) {
+    if (!glGetProgramBinary) return;
+
+    GLint len = 0;
+    glGetProgramiv(p->val, GL_PROGRAM_BINARY_LENGTH, &len);
+    if (len <= 0) return;
+
+    ks_size_t idlen;
+    char* id = my_cacheid(p, &idlen);
+    if (!id) return;
+
+    void* data = ks_malloc(len);
+    if (!data) {
+        ks_free(id);
+        return;
+    }
+
+    GLenum fmt;
+    GLsizei rlen = 0;
+    glGetProgramBinary(p->val, len, &rlen, &fmt, data);
+    if (glGetError() != GL_NO_ERROR || rlen <= 0) {
+        ks_free(data);
+        ks_free(id);
+        return;
+    }
+
+    /* Write to a temporary file, then rename, so readers never see partial entries */
+    char path[4096], tpath[4096 + 8];
+    my_cachepath(id, idlen, path, sizeof(path));
+    snprintf(tpath, sizeof(tpath), "%s.tmp", path);
+
+    FILE* fp = fopen(tpath, "wb");
+    if (fp) {
+        GLint wlen = rlen, widlen = idlen;
+        bool ok = fwrite(KSGL_CACHE_MAGIC, 1, 8, fp) == 8 && fwrite(&widlen, sizeof(widlen), 1, fp) == 1 && fwrite(id, 1, idlen, fp) == idlen
+            && fwrite(&fmt, sizeof(fmt), 1, fp) == 1 && fwrite(&wlen, sizeof(wlen), 1, fp) == 1 && fwrite(data, 1, rlen, fp) == rlen;
+        fclose(fp);
+        if (ok) {
+            rename(tpath, path);
+        } else {
+            remove(tpath);
+        }
+    }
+
+    ks_free(data);
+    ks_free(id);
+}
+
+/* Returns whether the driver compiles shaders in the background, and can be polled without blocking
+ */
+static bool my_parallel() {
+    if (my_khrparallel < 0) {
+        my_khrparallel = ksgl_hasext("GL_KHR_parallel_shader_compile") || ksgl_hasext("GL_ARB_parallel_shader_compile");
+        if (my_khrparallel) {
+            /* Let the driver use as many compiler threads as it likes */
+            void (APIENTRY *maxthreads)(GLuint) = (void (APIENTRY *)(GLuint))gl3wGetProcAddress("glMaxShaderCompilerThreadsKHR");
+            if (!maxthreads) maxthreads = (void (APIENTRY *)(GLuint))gl3wGetProcAddress("glMaxShaderCompilerThreadsARB");
+            if (maxthreads) maxthreads(0xFFFFFFFF);
+        }
+    }
+
+    return my_khrparallel != 0;
+}
+
+/* Returns whether a program has finished building, without blocking (if the driver supports it)
+ */
+static bool my_complete(struct ksgl_program* prog) {
+    if (!prog->pending || !my_parallel()) return true;
+
+    int done = 0;
+    glGetProgramiv(prog->val, GL_COMPLETION_STATUS_KHR, &done);
+    return done != 0;
+}
+
+static bool my_finish(struct ksgl_program* prog) {
+    if (prog->failed) {
+        KS_THROW(kst_Error, "Shader program failed to build");
+        return false;
+    } else if (!prog->pending) {
+        return true;
+    }
+    prog->pending = false;
+
+    /* This blocks until the driver is done */
+    bool ok = check_shader(prog->src_frag ? GL_VERTEX_SHADER : GL_COMPUTE_SHADER, prog->sh_vert) && (prog->sh_frag < 0 || check_shader(GL_FRAGMENT_SHADER, prog->sh_frag)) && check_program(prog->val);
+
+    /* Shaders are no longer needed once the program is linked */
+    glDeleteShader(prog->sh_vert);
+    if (prog->sh_frag >= 0) glDeleteShader(prog->sh_frag);
+    prog->sh_vert = prog->sh_frag = -1;
+
+    if (ok && my_cachedir) {
+        my_cachestore(prog);
+    }
+
+    /* Cache uniform information, so they are never looked up through OpenGL */
+    if (!ok || !my_reflect(prog)) {
+        prog->failed = true;
+        my_delprogram(prog);
+        return false;
+    }
+
+    return true;
+}
+
+/* Initialize a shader from sources, submitting all compile and link commands up front
+ * If 'wait' is false, status checks are deferred until 'ksgl_shader_ready()'
+ */
+static bool my_build(ksgl_shader self, ks_str src_vert, ks_str src_frag, bool wait) {
+    self->val = -1;
+    self->prog = NULL;
+    self->n_hits = self->n_misses = 0;
+
+    /* Share an existing program with the same sources */
+    ks_hash_t key = my_srckey(src_vert, src_frag);
+    struct ksgl_program* prog = my_findprogram(key, src_vert, src_frag);
+    if (prog) {
+        prog->refs++;
+        self->prog = prog;
+        self->val = prog->val;
+        return !wait || my_finish(prog);
+    }
+
+    /* Otherwise, create a new one (which is released in '__free' if there is an error) */
+    prog = self->prog = my_newprogram(key, src_vert, src_frag);
+    if (!prog) {
+        return false;
+    }
+
+    /* Try the program binary cache first */
+    if (my_cachedir) {
+        prog->val = my_cacheload(prog);
+        if (prog->val >= 0) {
+            my_cache_hits++;
+        } else {
+            my_cache_misses++;
+        }
+    }
+
+    if (prog->val < 0) {
+        /* Make sure the driver is allowed to use compiler threads before submitting */
+        if (!wait) my_parallel();
+
+        /* Submit compilation of both shaders and linking, before checking anything */
+        prog->sh_vert = compile_shader(src_frag ? GL_VERTEX_SHADER : GL_COMPUTE_SHADER, src_vert);
+        if (prog->sh_vert < 0) {
+            return false;
+        }
+        if (src_frag) {
+            prog->sh_frag = compile_shader(GL_FRAGMENT_SHADER, src_frag);
+            if (prog->sh_frag < 0) {
+                return false;
+            }
+        }
+
+        prog->val = make_program(src_frag ? 2 : 1, (int[]) { prog->sh_vert, prog->sh_frag });
+        if (prog->val < 0) {
+            return false;
+        }
+        prog->pending = true;
+    } else if (!my_reflect(prog)) {
+        return false;
+    }
+    self->val = prog->val;
+
+    if (!my_addprogram(prog)) {
+        return false;
+    }
+
+    return !wait || my_finish(prog);
+}
+
 static KS_TFUNC(T, init) {
     ksgl_shader self;
     ks_str src_vert, src_frag;
     KS_ARGS("self:* src_vert:* src_frag:*", &self, ksglt_shader, &src_vert, kst_str, &src_frag, kst_str);
 
-    self->val = -1;
-    
-    /* Compile vertex shader */
-    int sh_vert = compile_shader(GL_VERTEX_SHADER, src_vert);
-    if (sh_vert < 0) {
+    if (!my_build(self, src_vert, src_frag, true)) {
         return NULL;
     }
 
-    /* Compile fragment shader */
-    int sh_frag = compile_shader(GL_FRAGMENT_SHADER, src_frag);
-    if (sh_frag < 0) {
-        glDeleteShader(sh_vert);
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, compile_async) {
+    ks_str src_vert, src_frag;
+    KS_ARGS("src_vert:* src_frag:*", &src_vert, kst_str, &src_frag, kst_str);
+
+    return (kso)ksgl_shader_new(src_vert, src_frag, false);
+}
+
+static KS_TFUNC(T, ready) {
+    ksgl_shader self;
+    KS_ARGS("self:*", &self, ksglt_shader);
+
+    return KSO_BOOL(my_complete(self->prog));
+}
+
+static KS_TFUNC(T, wait) {
+    ksgl_shader self;
+    KS_ARGS("self:*", &self, ksglt_shader);
+
+    if (!ksgl_shader_ready(self)) {
         return NULL;
     }
 
-    self->val = make_program(2, (int[]) { sh_vert, sh_frag });
-    glDeleteShader(sh_vert);
-    glDeleteShader(sh_frag);
-    if (self->val < 0) {
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, cache) {
+    kso path = KSO_NONE;
+    KS_ARGS("?path", &path);
+
+    if (path != KSO_NONE && !kso_issub(path->type, kst_str)) {
+        KS_THROW(kst_TypeError, "Expected 'path' to be a 'str' or 'none', but got '%T' object", path);
         return NULL;
     }
 
+    KS_NDECREF(my_cachedir);
+    my_cachedir = NULL;
+    if (path != KSO_NONE) {
+        KS_INCREF(path);
+        my_cachedir = (ks_str)path;
+    }
+
     return KSO_NONE;
 }
 
+static KS_TFUNC(T, cache_stats) {
+    KS_ARGS("");
+
+    return (kso)ks_tuple_newn(2, (kso[]) {
+        (kso)ks_int_new(my_cache_hits),
+        (kso)ks_int_new(my_cache_misses)
+    });
+}
+
 static KS_TFUNC(T, integral) {
     ksgl_shader self;
     KS_ARGS("self:*", &self, ksglt_shader);
@@ -150,6 +1121,10 @@ static KS_TFUNC(T, use) {
     ksgl_shader self;
     KS_ARGS("self:*", &self, ksglt_shader);
 
+    if (!ksgl_shader_ready(self)) {
+        return NULL;
+    }
+
     glUseProgram(self->val);
     if (!ksgl_check()) {
         return NULL;
@@ -162,16 +1137,20 @@ static KS_TFUNC(T, uniformloc) {
     ks_str name;
     KS_ARGS("self:* name:*", &self, ksglt_shader, &name, kst_str);
 
-    int pos = glGetUniformLocation(self->val, name->data);
-    if (pos < 0) {
-        KS_THROW(kst_Error, "Unknown uniform %R", name);
+    if (!ksgl_shader_ready(self)) {
         return NULL;
     }
-    if (!ksgl_check()) {
+
+    struct ksgl_shader_uniform* u = ksgl_shader_getuniform(self, name);
+    if (!u) {
+        KS_THROW(kst_Error, "Unknown uniform %R", name);
+        return NULL;
+    } else if (u->loc < 0) {
+        KS_THROW(kst_Error, "Uniform %R is in a uniform block, and has no location", name);
         return NULL;
     }
 
-    return (kso)ks_int_new(pos);
+    return (kso)ks_int_new(u->loc);
 }
 
 static KS_TFUNC(T, uniform) {
@@ -180,136 +1159,115 @@ static KS_TFUNC(T, uniform) {
     kso val;
     KS_ARGS("self:* name:* val", &self, ksglt_shader, &name, kst_str, &val);
 
-    int pos = glGetUniformLocation(self->val, name->data);
-    if (pos < 0) {
+    if (!ksgl_shader_ready(self)) {
+        return NULL;
+    }
+
+    struct ksgl_shader_uniform* u = ksgl_shader_getuniform(self, name);
+    if (!u) {
         KS_THROW(kst_Error, "Unknown uniform %R", name);
         return NULL;
+    } else if (u->loc < 0) {
+        KS_THROW(kst_Error, "Uniform %R is in a uniform block, and cannot be set directly", name);
+        return NULL;
     }
 
-    if (kso_is_int(val)) {
-        /* Set as integer */
-        ks_cint v;
-        if (!kso_get_ci(val, &v)) {
-            return NULL;
-        }
+    if (!u->set) {
+        KS_THROW(kst_TypeError, "Uniform %R has an unsupported type (0x%x)", name, u->type);
+        return NULL;
+    }
+
+    if (!ksgl_shader_upload(self, u, val)) {
+        return NULL;
+    }
 
-        glUniform1i(pos, v);
+    return KSO_NONE;
+}
 
-    } else {
-        /* Some sort of matrix/vector */
+static KS_TFUNC(T, block_binding) {
+    ksgl_shader self;
+    ks_str name;
+    ks_cint binding;
+    KS_ARGS("self:* name:* binding:cint", &self, ksglt_shader, &name, kst_str, &binding);
 
-        nx_t vn;
-        kso ref = NULL;
-        if (!nx_get(val, nxd_F, &vn, &ref)) {
-            return NULL;
-        }
+    if (!ksgl_shader_ready(self)) {
+        return NULL;
+    }
 
-        if (vn.rank == 0) {
-            /* Scalar */
-            glUniform1f(pos, *(nx_F*)vn.data);
-        } else if (vn.rank == 1) {
-            /* Vector */
-            int n = vn.shape[0];
-            int sn = vn.strides[0];
-            #define GET(_i) (*(nx_F*)((ks_uint)vn.data + sn * (_i)))
-
-            if (n == 1) {
-                glUniform1f(pos, GET(0));
-            } else if (n == 2) {
-                glUniform2f(pos, GET(0), GET(1));
-            } else if (n == 3) {
-                glUniform3f(pos, GET(0), GET(1), GET(2));
-            } else if (n == 4) {
-                glUniform4f(pos, GET(0), GET(1), GET(2), GET(3));
-            } else {
-                KS_THROW(kst_SizeError, "Expected rank-1 array to have length 1, 2, 3, or 4 for shader uniform");
-                KS_NDECREF(ref);
-                return NULL;
-            }
-            #undef GET
-        } else if (vn.rank == 2) {
-            /* Vector */
-            int m = vn.shape[0], n = vn.shape[1];
-            int sm = vn.strides[0], sn = vn.strides[1];
-            GLfloat v[16];
-
-            #define GET(_i, _j) (*(nx_F*)((ks_uint)vn.data + sm * (_i) + sn * (_j)))
-
-            /* Copy into 'v', as dense array */
-            #define COPY() do { \
-                int i, j; \
-                for (i = 0; i < m; ++i) { \
-                    for (j = 0; j < n; ++j) { \
-                        v[i * n + j] = GET(i, j); \
-                    } \
-                } \
-            } while (0)
-
-            if (m == 1 && n == 1) {
-                glUniform1f(pos, GET(0, 0));
-            } else if (m == 1 && n == 2) {
-                glUniform2f(pos, GET(0, 0), GET(0, 1));
-            } else if (m == 1 && n == 3) {
-                glUniform3f(pos, GET(0, 0), GET(0, 1), GET(0, 2));
-            } else if (m == 1 && n == 4) {
-                glUniform4f(pos, GET(0, 0), GET(0, 1), GET(0, 2), GET(0, 3));
-            } else if (m == 1 && n == 1) {
-                glUniform1f(pos, GET(0, 0));
-            } else if (m == 2 && n == 1) {
-                glUniform2f(pos, GET(0, 0), GET(1, 0));
-            } else if (m == 3 && n == 1) {
-                glUniform3f(pos, GET(0, 0), GET(1, 0), GET(2, 0));
-            } else if (m == 4 && n == 1) {
-                glUniform4f(pos, GET(0, 0), GET(1, 0), GET(2, 0), GET(3, 0));
-
-            } else if (m == 2 && n == 2) {
-                COPY();
-                glUniformMatrix2fv(pos, 1, GL_TRUE, v);
-            } else if (m == 2 && n == 3) {
-                COPY();
-                glUniformMatrix2x3fv(pos, 1, GL_TRUE, v);
-            } else if (m == 2 && n == 4) {
-                COPY();
-                glUniformMatrix2x4fv(pos, 1, GL_TRUE, v);
-            
-            } else if (m == 3 && n == 2) {
-                COPY();
-                glUniformMatrix3x2fv(pos, 1, GL_TRUE, v);
-            } else if (m == 3 && n == 3) {
-                COPY();
-                glUniformMatrix3fv(pos, 1, GL_TRUE, v);
-            } else if (m == 3 && n == 4) {
-                COPY();
-                glUniformMatrix3x4fv(pos, 1, GL_TRUE, v);
-
-            } else if (m == 4 && n == 2) {
-                COPY();
-                glUniformMatrix4x2fv(pos, 1, GL_TRUE, v);
-            } else if (m == 4 && n == 3) {
-                COPY();
-                glUniformMatrix4x3fv(pos, 1, GL_TRUE, v);
-            } else if (m == 4 && n == 4) {
-                COPY();
-                glUniformMatrix4fv(pos, 1, GL_TRUE, v);
-
-            } else {
-                KS_THROW(kst_SizeError, "Expected rank-2 array to have length 1, 2, 3, or 4 for both shapes");
-                KS_NDECREF(ref);
-                return NULL;
-            }
+    struct ksgl_shader_block* b = ksgl_shader_getblock(self, name);
+    if (!b) {
+        KS_THROW(kst_Error, "Unknown uniform block %R", name);
+        return NULL;
+    }
 
-            #undef GET
-        } else {
-            KS_THROW(kst_SizeError, "Only expected rank-0, rank-1, or rank-2 arrays for shader uniform");
-            KS_NDECREF(ref);
+    if (b->binding != binding) {
+        glUniformBlockBinding(self->val, b->index, binding);
+        if (!ksgl_check()) {
             return NULL;
         }
+        b->binding = binding;
+    }
 
-        KS_NDECREF(ref);
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, handle) {
+    ksgl_shader self;
+    ks_str name;
+    KS_ARGS("self:* name:*", &self, ksglt_shader, &name, kst_str);
+
+    if (!ksgl_shader_ready(self)) {
+        return NULL;
+    }
+
+    struct ksgl_shader_uniform* u = ksgl_shader_getuniform(self, name);
+    if (!u) {
+        KS_THROW(kst_Error, "Unknown uniform %R", name);
+        return NULL;
+    } else if (u->loc < 0) {
+        KS_THROW(kst_Error, "Uniform %R is in a uniform block, and cannot be set directly", name);
+        return NULL;
+    } else if (!u->set) {
+        KS_THROW(kst_TypeError, "Uniform %R has an unsupported type (0x%x)", name, u->type);
+        return NULL;
     }
 
+    ksgl_uniform res = KSO_NEW(ksgl_uniform, ksglt_uniform);
+    KS_INCREF(self);
+    res->shader = self;
+    res->val = u;
 
-    return KSO_NONE;
+    return (kso)res;
+}
+
+static KS_TFUNC(T, getattr) {
+    ksgl_shader self;
+    ks_str attr;
+    KS_ARGS("self:* attr:*", &self, ksglt_shader, &attr, kst_str);
+
+    if (ks_str_eq_c(attr, "uniforms", 8)) {
+        if (!ksgl_shader_ready(self)) {
+            return NULL;
+        }
+        return my_reflcopy(self->prog->refl_uniforms);
+    } else if (ks_str_eq_c(attr, "attributes", 10)) {
+        if (!ksgl_shader_ready(self)) {
+            return NULL;
+        }
+        return my_reflcopy(self->prog->refl_attributes);
+    } else if (ks_str_eq_c(attr, "uniform_blocks", 14)) {
+        if (!ksgl_shader_ready(self)) {
+            return NULL;
+        }
+        return my_reflcopy(self->prog->refl_blocks);
+    } else if (ks_str_eq_c(attr, "uniform_hits", 12)) {
+        return (kso)ks_int_new(self->n_hits);
+    } else if (ks_str_eq_c(attr, "uniform_misses", 14)) {
+        return (kso)ks_int_new(self->n_misses);
+    }
+
+    KS_THROW_ATTR(self, attr);
+    return NULL;
 }
 
 
@@ -324,10 +1282,20 @@ void _ksgl_shader() {
         {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, src_vert, src_frag)", "")},
 
         {"__integral",             ksf_wrap(T_integral_, T_NAME ".__integral(self)", "Converts to an integer (the OpenGL handle)")},
+        {"__getattr",              ksf_wrap(T_getattr_, T_NAME ".__getattr(self, attr)", "Attributes 'uniforms' and 'attributes' map names to '(loc, type, size)', and 'uniform_blocks' maps names to '(index, size, nuniforms)'")},
+
+        {"cache",                  ksf_wrap(T_cache_, T_NAME ".cache(path=none)", "Cache linked program binaries in the directory 'path' (which must exist), and load them instead of compiling when the sources and driver match. Giving 'none' disables the cache")},
+        {"cache_stats",            ksf_wrap(T_cache_stats_, T_NAME ".cache_stats()", "Return a tuple of '(hits, misses)' for the program binary cache")},
+
+        {"compile_async",          ksf_wrap(T_compile_async_, T_NAME ".compile_async(src_vert, src_frag)", "Submit compilation and linking of a shader without waiting for the result, so many shaders can be compiled in parallel by the driver. Errors are reported by 'wait()', or the first time the shader is used")},
+        {"ready",                  ksf_wrap(T_ready_, T_NAME ".ready(self)", "Returns whether the shader has finished compiling, without blocking. Without 'KHR_parallel_shader_compile', this always returns true")},
+        {"wait",                   ksf_wrap(T_wait_, T_NAME ".wait(self)", "Wait for the shader to finish compiling, and throw an error if compiling or linking failed")},
 
         {"use",                    ksf_wrap(T_use_, T_NAME ".use(self)", "Set this shader to the current OpenGL shader")},
-        {"uniform",                ksf_wrap(T_uniform_, T_NAME ".uniform(self, name, val)", "Set the uniform 'name' to a given value")},
+        {"uniform",                ksf_wrap(T_uniform_, T_NAME ".uniform(self, name, val)", "Set the uniform 'name' to a given value. For array uniforms, an array of 'N' elements (i.e. shape '(N, 4, 4)' for 'mat4[]') sets the first 'N' elements. Uploads are skipped if the value is the same as the last one")},
         {"uniformloc",             ksf_wrap(T_uniformloc_, T_NAME ".uniformloc(self, name)", "Return the uniform location")},
+        {"block_binding",          ksf_wrap(T_block_binding_, T_NAME ".block_binding(self, name, binding)", "Set the uniform block 'name' to read from the buffer bound to 'binding' (see 'gl.UBO.bind()')")},
+        {"handle",                 ksf_wrap(T_handle_, T_NAME ".handle(self, name)", "Return a 'gl.Uniform' handle for the uniform 'name', which can be set without looking it up")},
 
     ));
 }
@@ -0,0 +1,359 @@
+/* shaderlibrary.c - gl.ShaderLibrary type
+ *
+ * @author: Cade Brown <cade@kscript.org>
+ */
+#include <ksgl.h>
+
+#define T_NAME M_NAME ".ShaderLibrary"
+
+
+/* Internals */
+
+/* Maximum number of feature flags (bits in a variant mask) */
+#define KSGL_FLAGS_MAX 62
+
+
+/* Convert 'flags' (an integer mask, or an iterable of flag names) to a variant mask
+ */
+static bool my_getmask(ksgl_shaderlibrary self, kso flags, ks_cint* out) {
+    if (kso_is_int(flags)) {
+        if (!kso_get_ci(flags, out)) {
+            return false;
+        }
+        if (*out < 0 || *out >= ((ks_cint)1 << self->flags->len)) {
+            KS_THROW(kst_Error, "Invalid variant mask %i for %i flags", (int)*out, (int)self->flags->len);
+            return false;
+        }
+        return true;
+    }
+
+    ks_list names = ks_list_newi(flags);
+    if (!names) {
+        return false;
+    }
+
+    *out = 0;
+    int i, j;
+    for (i = 0; i < names->len; ++i) {
+        kso name = names->elems[i];
+        if (!kso_issub(name->type, kst_str)) {
+            KS_THROW(kst_TypeError, "Expected flag names to be 'str' objects, but got '%T' object", name);
+            KS_DECREF(names);
+            return false;
+        }
+
+        for (j = 0; j < self->flags->len; ++j) {
+            ks_str f = (ks_str)self->flags->elems[j];
+            if (f->len_b == ((ks_str)name)->len_b && memcmp(f->data, ((ks_str)name)->data, f->len_b) == 0) break;
+        }
+        if (j >= self->flags->len) {
+            KS_THROW(kst_KeyError, "Unknown flag %R", name);
+            KS_DECREF(names);
+            return false;
+        }
+
+        *out |= (ks_cint)1 << j;
+    }
+
+    KS_DECREF(names);
+    return true;
+}
+
+/* Create the source of a variant, by adding '#define <flag> 1' for each flag in 'mask' directly
+ *   after the '#version' directive (which must come first in GLSL, apart from comments)
+ * A '#line' directive is added afterwards, so error messages refer to lines of the base source
+ */
+static ks_str my_variant(ksgl_shaderlibrary self, ks_str src, ks_cint mask) {
+    /* Find the end of the '#version' line (and how many lines come before it), if there is one
+     * Only whitespace and comments (i.e. a license header) may come before it
+     */
+    ks_size_t pos = 0, line = 0, p = 0;
+    while (p < src->len_b) {
+        char c = src->data[p];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            if (c == '\n') line++;
+            p++;
+        } else if (c == '/' && p + 1 < src->len_b && src->data[p + 1] == '/') {
+            /* Line comment, up to (but not including) the newline */
+            while (p < src->len_b && src->data[p] != '\n') p++;
+        } else if (c == '/' && p + 1 < src->len_b && src->data[p + 1] == '*') {
+            /* Block comment, which may span lines */
+            p += 2;
+            while (p < src->len_b && !(src->data[p] == '*' && p + 1 < src->len_b && src->data[p + 1] == '/')) {
+                if (src->data[p] == '\n') line++;
+                p++;
+            }
+            p = p < src->len_b ? p + 2 : p;
+        } else {
+            break;
+        }
+    }
+
+    bool nl = false;
+    if (src->len_b - p >= 8 && memcmp(src->data + p, "#version", 8) == 0) {
+        while (p < src->len_b && src->data[p] != '\n') p++;
+        if (p < src->len_b) {
+            p++;
+        } else {
+            /* No newline after it, so add one */
+            nl = true;
+        }
+        pos = p;
+        line++;
+    } else {
+        line = 0;
+    }
+
+    /* Compute the size of the injected lines */
+    ks_size_t len = src->len_b + 32;
+    int i;
+    for (i = 0; i < self->flags->len; ++i) {
+        if (mask & ((ks_cint)1 << i)) len += ((ks_str)self->flags->elems[i])->len_b + 12;
+    }
+
+    char* data = ks_malloc(len);
+    if (!data) {
+        KS_THROW(kst_Error, "Failed to allocate shader source");
+        return NULL;
+    }
+
+    ks_size_t n = 0;
+    memcpy(data, src->data, pos);
+    n += pos;
+    if (nl) data[n++] = '\n';
+    for (i = 0; i < self->flags->len; ++i) {
+        if (mask & ((ks_cint)1 << i)) {
+            ks_str f = (ks_str)self->flags->elems[i];
+            memcpy(data + n, "#define ", 8);
+            n += 8;
+            memcpy(data + n, f->data, f->len_b);
+            n += f->len_b;
+            memcpy(data + n, " 1\n", 3);
+            n += 3;
+        }
+    }
+    n += snprintf(data + n, len - n, "#line %i\n", (int)line + 1);
+    memcpy(data + n, src->data + pos, src->len_b - pos);
+    n += src->len_b - pos;
+
+    ks_str res = ks_str_new(n, data);
+    ks_free(data);
+    return res;
+}
+
+/* Return the variant for 'mask' (a new reference), building it if it has not been built yet
+ */
+static ksgl_shader my_get(ksgl_shaderlibrary self, ks_cint mask, bool wait) {
+    int i;
+    for (i = 0; i < self->n_variants; ++i) {
+        if (self->masks[i] == mask) {
+            KS_INCREF(self->variants[i]);
+            return self->variants[i];
+        }
+    }
+
+    ks_str src_vert = my_variant(self, self->src_vert, mask);
+    if (!src_vert) {
+        return NULL;
+    }
+    ks_str src_frag = my_variant(self, self->src_frag, mask);
+    if (!src_frag) {
+        KS_DECREF(src_vert);
+        return NULL;
+    }
+
+    ksgl_shader res = ksgl_shader_new(src_vert, src_frag, wait);
+    KS_DECREF(src_vert);
+    KS_DECREF(src_frag);
+    if (!res) {
+        return NULL;
+    }
+
+    ks_cint* masks = ks_realloc(self->masks, sizeof(*self->masks) * (self->n_variants + 1));
+    if (!masks) {
+        KS_DECREF(res);
+        KS_THROW(kst_Error, "Failed to allocate variants");
+        return NULL;
+    }
+    self->masks = masks;
+
+    ksgl_shader* variants = ks_realloc(self->variants, sizeof(*self->variants) * (self->n_variants + 1));
+    if (!variants) {
+        KS_DECREF(res);
+        KS_THROW(kst_Error, "Failed to allocate variants");
+        return NULL;
+    }
+    self->variants = variants;
+
+    i = self->n_variants++;
+    self->masks[i] = mask;
+    KS_INCREF(res);
+    self->variants[i] = res;
+
+    return res;
+}
+
+
+/* C-API */
+
+
+/* Type Functions */
+
+static KS_TFUNC(T, free) {
+    ksgl_shaderlibrary self;
+    KS_ARGS("self:*", &self, ksglt_shaderlibrary);
+
+    int i;
+    for (i = 0; i < self->n_variants; ++i) {
+        KS_DECREF(self->variants[i]);
+    }
+    ks_free(self->masks);
+    ks_free(self->variants);
+
+    KS_NDECREF(self->src_vert);
+    KS_NDECREF(self->src_frag);
+    KS_NDECREF(self->flags);
+
+    KSO_DEL(self);
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, init) {
+    ksgl_shaderlibrary self;
+    ks_str src_vert, src_frag;
+    kso flags;
+    KS_ARGS("self:* src_vert:* src_frag:* flags", &self, ksglt_shaderlibrary, &src_vert, kst_str, &src_frag, kst_str, &flags);
+
+    self->n_variants = 0;
+    self->masks = NULL;
+    self->variants = NULL;
+    KS_INCREF(src_vert);
+    self->src_vert = src_vert;
+    KS_INCREF(src_frag);
+    self->src_frag = src_frag;
+    self->flags = NULL;
+
+    ks_list names = ks_list_newi(flags);
+    if (!names) {
+        return NULL;
+    }
+
+    int i;
+    for (i = 0; i < names->len; ++i) {
+        if (!kso_issub(names->elems[i]->type, kst_str)) {
+            KS_THROW(kst_TypeError, "Expected flag names to be 'str' objects, but got '%T' object", names->elems[i]);
+            KS_DECREF(names);
+            return NULL;
+        }
+    }
+    if (names->len > KSGL_FLAGS_MAX) {
+        KS_THROW(kst_Error, "Too many flags (%i), the maximum is %i", (int)names->len, KSGL_FLAGS_MAX);
+        KS_DECREF(names);
+        return NULL;
+    }
+
+    self->flags = ks_tuple_new(names->len, names->elems);
+    KS_DECREF(names);
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, getattr) {
+    ksgl_shaderlibrary self;
+    ks_str attr;
+    KS_ARGS("self:* attr:*", &self, ksglt_shaderlibrary, &attr, kst_str);
+
+    if (ks_str_eq_c(attr, "flags", 5)) {
+        return KS_NEWREF(self->flags);
+    } else if (ks_str_eq_c(attr, "variants", 8)) {
+        return (kso)ks_int_new(self->n_variants);
+    }
+
+    KS_THROW_ATTR(self, attr);
+    return NULL;
+}
+
+static KS_TFUNC(T, mask) {
+    ksgl_shaderlibrary self;
+    kso flags;
+    KS_ARGS("self:* flags", &self, ksglt_shaderlibrary, &flags);
+
+    ks_cint mask;
+    if (!my_getmask(self, flags, &mask)) {
+        return NULL;
+    }
+
+    return (kso)ks_int_new(mask);
+}
+
+static KS_TFUNC(T, get) {
+    ksgl_shaderlibrary self;
+    kso flags = KSO_NONE;
+    KS_ARGS("self:* ?flags", &self, ksglt_shaderlibrary, &flags);
+
+    ks_cint mask = 0;
+    if (flags != KSO_NONE && !my_getmask(self, flags, &mask)) {
+        return NULL;
+    }
+
+    ksgl_shader res = my_get(self, mask, true);
+    if (!res) {
+        return NULL;
+    }
+
+    /* Variants that were prewarmed may still be compiling */
+    if (!ksgl_shader_ready(res)) {
+        KS_DECREF(res);
+        return NULL;
+    }
+
+    return (kso)res;
+}
+
+static KS_TFUNC(T, prewarm) {
+    ksgl_shaderlibrary self;
+    kso variants;
+    KS_ARGS("self:* variants", &self, ksglt_shaderlibrary, &variants);
+
+    ks_list vs = ks_list_newi(variants);
+    if (!vs) {
+        return NULL;
+    }
+
+    /* Submit all of them, without waiting on any */
+    int i;
+    for (i = 0; i < vs->len; ++i) {
+        ks_cint mask;
+        if (!my_getmask(self, vs->elems[i], &mask)) {
+            KS_DECREF(vs);
+            return NULL;
+        }
+
+        ksgl_shader sh = my_get(self, mask, false);
+        if (!sh) {
+            KS_DECREF(vs);
+            return NULL;
+        }
+        KS_DECREF(sh);
+    }
+
+    KS_DECREF(vs);
+    return KSO_NONE;
+}
+
+
+/* Export */
+
+ks_type ksglt_shaderlibrary;
+
+void _ksgl_shaderlibrary() {
+    ksglt_shaderlibrary = ks_type_new(T_NAME, kst_object, sizeof(struct ksgl_shaderlibrary_s), -1, "Variants of a shader, which are built from the same sources with different feature flags '#define'd", KS_IKV(
+        {"__free",                 ksf_wrap(T_free_, T_NAME ".__free(self)", "")},
+        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, src_vert, src_frag, flags)", "Create a library from base sources, and a list of feature flag names. Flag 'i' is bit '1 << i' of a variant mask")},
+        {"__getattr",              ksf_wrap(T_getattr_, T_NAME ".__getattr(self, attr)", "")},
+
+        {"mask",                   ksf_wrap(T_mask_, T_NAME ".mask(self, flags)", "Return the variant mask for a list of flag names")},
+        {"get",                    ksf_wrap(T_get_, T_NAME ".get(self, flags=none)", "Return the 'gl.Shader' with the given flags (a mask, or a list of flag names) defined as '1' after the '#version' directive. Each variant is only compiled once")},
+        {"prewarm",                ksf_wrap(T_prewarm_, T_NAME ".prewarm(self, variants)", "Start compiling each of 'variants' (masks, or lists of flag names) in the background (see 'gl.Shader.compile_async()'), so that 'get()' does not have to compile them later")},
+    ));
+}
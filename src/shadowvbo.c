@@ -0,0 +1,350 @@
+/* shadowvbo.c - gl.ShadowVBO type
+ *
+ * @author: Cade Brown <cade@kscript.org>
+ */
+#include <ksgl.h>
+
+#define T_NAME M_NAME ".ShadowVBO"
+
+
+/* Internals */
+
+/* Number of recorded ranges past which they are merged early, to bound memory between flushes */
+#define KSGL_DIRTY_MERGE 4096
+
+/* Compare ranges by their start */
+static int my_dirtycmp(const void* a, const void* b) {
+    ks_ssize_t sa = ((const struct ksgl_dirty*)a)->start, sb = ((const struct ksgl_dirty*)b)->start;
+    return sa < sb ? -1 : (sa > sb ? 1 : 0);
+}
+
+/* Sort the dirty ranges, and merge ones that overlap or are less than 'self->gap' bytes apart
+ */
+static void my_coalesce(ksgl_shadowvbo self) {
+    if (self->n_dirty <= 1) return;
+
+    qsort(self->dirty, self->n_dirty, sizeof(*self->dirty), my_dirtycmp);
+
+    int i, n = 0;
+    for (i = 1; i < self->n_dirty; ++i) {
+        struct ksgl_dirty* last = &self->dirty[n];
+        if (self->dirty[i].start <= last->end + self->gap) {
+            if (self->dirty[i].end > last->end) last->end = self->dirty[i].end;
+        } else {
+            self->dirty[++n] = self->dirty[i];
+        }
+    }
+    self->n_dirty = n + 1;
+}
+
+/* Record that bytes [start, end) of the mirror were modified
+ */
+static bool my_mark(ksgl_shadowvbo self, ks_ssize_t start, ks_ssize_t end) {
+    if (start >= end) return true;
+
+    /* Sequential edits (i.e. in a loop) extend the last range */
+    if (self->n_dirty > 0) {
+        struct ksgl_dirty* last = &self->dirty[self->n_dirty - 1];
+        if (start >= last->start && start <= last->end + self->gap) {
+            if (end > last->end) last->end = end;
+            return true;
+        }
+    }
+
+    if (self->n_dirty >= self->max_dirty) {
+        if (self->n_dirty >= KSGL_DIRTY_MERGE) {
+            my_coalesce(self);
+        }
+        if (self->n_dirty >= self->max_dirty) {
+            int nmax = self->max_dirty * 2 + 16;
+            struct ksgl_dirty* p = ks_realloc(self->dirty, sizeof(*self->dirty) * nmax);
+            if (!p) {
+                KS_THROW(kst_Error, "Failed to allocate data");
+                return false;
+            }
+            self->dirty = p;
+            self->max_dirty = nmax;
+        }
+    }
+
+    self->dirty[self->n_dirty].start = start;
+    self->dirty[self->n_dirty].end = end;
+    self->n_dirty++;
+    return true;
+}
+
+/* Return the number of bytes in the mirror, which is the size of every upload
+ */
+static ks_ssize_t my_size(ksgl_shadowvbo self) {
+    nx_t x = self->data->val;
+    return x.dtype->size * nx_szprod(x.rank, x.shape);
+}
+
+/* Upload the dirty ranges of the mirror, returning the number of uploads (or -1 and throwing an error)
+ */
+static int my_flush(ksgl_shadowvbo self) {
+    if (self->n_dirty == 0) return 0;
+
+    my_coalesce(self);
+
+    ks_ssize_t total = 0;
+    int i;
+    for (i = 0; i < self->n_dirty; ++i) {
+        total += self->dirty[i].end - self->dirty[i].start;
+    }
+
+    unsigned char* src = self->data->val.data;
+    ks_ssize_t size = my_size(self);
+    int n = 0;
+    if (total > self->full * size) {
+        /* Most of it changed, so one upload (to new storage, to avoid waiting on the GPU) is cheaper */
+        if (!ksgl_vbo_write(&self->vbo, 0, src, size, KSGL_WRITE_ORPHAN)) {
+            return -1;
+        }
+        total = size;
+        n = 1;
+    } else {
+        for (i = 0; i < self->n_dirty; ++i) {
+            struct ksgl_dirty* d = &self->dirty[i];
+            if (!ksgl_vbo_write(&self->vbo, d->start, src + d->start, d->end - d->start, KSGL_WRITE_SUBDATA)) {
+                return -1;
+            }
+        }
+        n = self->n_dirty;
+    }
+
+    self->n_dirty = 0;
+    self->n_flushes++;
+    self->n_uploads += n;
+    self->n_bytes += total;
+    return n;
+}
+
+/* Return the number of bytes in each row (element along the first axis) of the mirror
+ */
+static ks_ssize_t my_rowsize(ksgl_shadowvbo self) {
+    nx_t x = self->data->val;
+    return x.rank > 0 ? x.dtype->size * nx_szprod(x.rank - 1, x.shape + 1) : x.dtype->size;
+}
+
+
+/* C-API */
+
+/* Type Functions */
+
+static KS_TFUNC(T, free) {
+    ksgl_shadowvbo self;
+    KS_ARGS("self:*", &self, ksglt_shadowvbo);
+
+    if (self->vbo.val >= 0) ksgl_delete(KSGL_OBJ_BUFFER, self->vbo.val, true);
+    KS_NDECREF(self->data);
+    ks_free(self->dirty);
+
+    KSO_DEL(self);
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, init) {
+    ksgl_shadowvbo self;
+    kso data;
+    ks_cint usage = GL_DYNAMIC_DRAW, gap = 256;
+    ks_cfloat full = 0.5;
+    KS_ARGS("self:* data ?usage:cint ?gap:cint ?full:cfloat", &self, ksglt_shadowvbo, &data, &usage, &gap, &full);
+
+    self->vbo.val = -1;
+    self->data = NULL;
+    self->n_dirty = self->max_dirty = 0;
+    self->dirty = NULL;
+    self->gap = gap < 0 ? 0 : gap;
+    self->full = full;
+    self->n_flushes = self->n_uploads = self->n_bytes = 0;
+
+    /* Make the mirror, which is a dense copy of 'data' (or zeros, if it is a size) */
+    if (kso_is_int(data)) {
+        ks_cint sz;
+        if (!kso_get_ci(data, &sz)) {
+            return NULL;
+        } else if (sz < 0) {
+            KS_THROW(kst_Error, "Buffer size must be non-negative, but got %i", (int)sz);
+            return NULL;
+        }
+
+        void* zeros = ks_malloc(sz > 0 ? sz : 1);
+        if (!zeros) {
+            KS_THROW(kst_Error, "Failed to allocate data");
+            return NULL;
+        }
+        memset(zeros, 0, sz);
+        self->data = nx_array_newc(nxt_array, zeros, nxd_u8, 1, (ks_size_t[]){ sz }, NULL);
+        ks_free(zeros);
+    } else {
+        nx_t x;
+        kso ref = NULL;
+        if (!nx_get(data, NULL, &x, &ref)) {
+            return NULL;
+        }
+        self->data = nx_array_newc(nxt_array, x.data, x.dtype, x.rank, x.shape, x.strides);
+        KS_NDECREF(ref);
+    }
+    if (!self->data) {
+        return NULL;
+    }
+
+    if (!ksgl_vbo_init(&self->vbo, my_size(self), self->data->val.data, usage)) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, array) {
+    ksgl_shadowvbo self;
+    KS_ARGS("self:*", &self, ksglt_shadowvbo);
+
+    return KS_NEWREF(self->data);
+}
+
+static KS_TFUNC(T, set) {
+    ksgl_shadowvbo self;
+    ks_cint index;
+    kso val;
+    KS_ARGS("self:* index:cint val", &self, ksglt_shadowvbo, &index, &val);
+
+    nx_t x = self->data->val;
+    if (x.rank < 1) {
+        KS_THROW(kst_Error, "Cannot index a rank-0 mirror");
+        return NULL;
+    }
+
+    nx_t v;
+    kso ref = NULL;
+    if (!nx_get(val, NULL, &v, &ref)) {
+        return NULL;
+    }
+
+    /* A value of the full rank sets that many rows, otherwise it sets (and is broadcast to) one row */
+    ks_ssize_t n = v.rank == x.rank ? v.shape[0] : 1;
+    if (index < 0 || index + n > x.shape[0]) {
+        KS_NDECREF(ref);
+        KS_THROW(kst_IndexError, "Rows [%i, %i) are out of bounds for %i rows", (int)index, (int)(index + n), (int)x.shape[0]);
+        return NULL;
+    }
+
+    nx_t r = x;
+    r.data = (unsigned char*)x.data + index * x.strides[0];
+    r.shape[0] = n;
+    if (v.rank < x.rank) {
+        /* Drop the first axis, so the value broadcasts against a single row */
+        r = nx_make(r.data, r.dtype, r.rank - 1, r.shape + 1, r.strides + 1);
+    }
+
+    bool ok = nx_cast(v, r);
+    KS_NDECREF(ref);
+    if (!ok) {
+        return NULL;
+    }
+
+    ks_ssize_t rs = my_rowsize(self);
+    if (!my_mark(self, index * rs, (index + n) * rs)) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, mark) {
+    ksgl_shadowvbo self;
+    ks_cint start, stop = -1;
+    KS_ARGS("self:* start:cint ?stop:cint", &self, ksglt_shadowvbo, &start, &stop);
+
+    nx_t x = self->data->val;
+    ks_cint nrows = x.rank > 0 ? x.shape[0] : 1;
+    if (stop < 0) stop = start + 1;
+    if (start < 0 || stop > nrows || start > stop) {
+        KS_THROW(kst_IndexError, "Rows [%i, %i) are out of bounds for %i rows", (int)start, (int)stop, (int)nrows);
+        return NULL;
+    }
+
+    ks_ssize_t rs = my_rowsize(self);
+    if (!my_mark(self, start * rs, stop * rs)) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, flush) {
+    ksgl_shadowvbo self;
+    KS_ARGS("self:*", &self, ksglt_shadowvbo);
+
+    int n = my_flush(self);
+    if (n < 0) {
+        return NULL;
+    }
+
+    return (kso)ks_int_new(n);
+}
+
+static KS_TFUNC(T, write) {
+    ksgl_shadowvbo self;
+    int nargs;
+    kso* args;
+    KS_ARGS("self:* *args", &self, ksglt_shadowvbo, &nargs, &args);
+
+    KS_THROW(kst_Error, "'%T' objects are written through the mirror (use 'set()', or 'array()' and 'mark()')", self);
+    return NULL;
+}
+
+static KS_TFUNC(T, map) {
+    ksgl_shadowvbo self;
+    int nargs;
+    kso* args;
+    KS_ARGS("self:* *args", &self, ksglt_shadowvbo, &nargs, &args);
+
+    KS_THROW(kst_Error, "'%T' objects cannot be mapped (use 'array()' and 'mark()')", self);
+    return NULL;
+}
+
+static KS_TFUNC(T, resize) {
+    ksgl_shadowvbo self;
+    int nargs;
+    kso* args;
+    KS_ARGS("self:* *args", &self, ksglt_shadowvbo, &nargs, &args);
+
+    KS_THROW(kst_Error, "'%T' objects cannot be resized, since the mirror is a fixed size", self);
+    return NULL;
+}
+
+static KS_TFUNC(T, flush_stats) {
+    ksgl_shadowvbo self;
+    KS_ARGS("self:*", &self, ksglt_shadowvbo);
+
+    return (kso)ks_tuple_newn(4, (kso[]) {
+        (kso)ks_int_new(self->n_flushes),
+        (kso)ks_int_new(self->n_uploads),
+        (kso)ks_int_new(self->n_bytes),
+        (kso)ks_int_new(self->n_dirty)
+    });
+}
+
+
+/* Export */
+
+ks_type ksglt_shadowvbo;
+
+void _ksgl_shadowvbo() {
+    ksglt_shadowvbo = ks_type_new(T_NAME, ksglt_vbo, sizeof(struct ksgl_shadowvbo_s), -1, "Vertex buffer with a CPU-side mirror, where edits are recorded and uploaded together in as few calls as possible", KS_IKV(
+        {"__free",                 ksf_wrap(T_free_, T_NAME ".__free(self)", "")},
+        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, data, usage=gl.DYNAMIC_DRAW, gap=256, full=0.5)", "Create a buffer from 'data' (an array, which is copied into the mirror, or a size in bytes). When flushing, modified ranges less than 'gap' bytes apart are uploaded together, and if more than 'full' (a fraction of the size) would be uploaded, the whole buffer is uploaded instead")},
+
+        {"array",                  ksf_wrap(T_array_, T_NAME ".array(self)", "Return the mirror (an 'nx' array). Edits to it directly must be recorded with 'mark()'")},
+        {"set",                    ksf_wrap(T_set_, T_NAME ".set(self, index, val)", "Set rows of the mirror starting at 'index' (along its first axis) to 'val', and record them as modified. If 'val' has the same rank as the mirror, it sets 'len(val)' rows, otherwise it is broadcast to a single row")},
+        {"mark",                   ksf_wrap(T_mark_, T_NAME ".mark(self, start, stop=start+1)", "Record rows '[start, stop)' of the mirror as modified")},
+        {"flush",                  ksf_wrap(T_flush_, T_NAME ".flush(self)", "Upload the modified ranges, merging ones that overlap or are close together, and return the number of uploads made. Must be done before drawing")},
+
+        {"write",                  ksf_wrap(T_write_, T_NAME ".write(self, data, offset=0, mode='subdata')", "Not supported, since it would bypass the mirror")},
+        {"map",                    ksf_wrap(T_map_, T_NAME ".map(self, offset=0, size=-1, access=gl.MAP_WRITE_BIT, dtype=nx.uint8)", "Not supported, since it would bypass the mirror")},
+        {"resize",                 ksf_wrap(T_resize_, T_NAME ".resize(self, size, preserve=true)", "Not supported, since the mirror is a fixed size")},
+        {"flush_stats",            ksf_wrap(T_flush_stats_, T_NAME ".flush_stats(self)", "Return a tuple of '(flushes, uploads, bytes, pending)', where 'pending' is the number of ranges waiting to be flushed")},
+    ));
+}
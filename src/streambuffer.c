@@ -0,0 +1,329 @@
+/* streambuffer.c - gl.StreamBuffer type
+ *
+ * @author: Cade Brown <cade@kscript.org>
+ */
+#include <ksgl.h>
+
+#define T_NAME M_NAME ".StreamBuffer"
+
+
+/* Internals */
+
+/* Default size of the buffer */
+#define KSGL_STREAMBUFFER_SIZE (16 * 1024 * 1024)
+
+/* Flags for persistent mapping of the buffer */
+#define KSGL_STREAMBUFFER_FLAGS (GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+
+/* Return the size of each region, which is a multiple of the alignment (so every region starts aligned)
+ */
+static ks_ssize_t my_regionsize(ksgl_streambuffer self) {
+    return self->size / self->n_regions / self->align * self->align;
+}
+
+/* Release views from 'alloc()' that nothing else references, returning whether any are still in use
+ */
+static bool my_views_inuse(ksgl_streambuffer self) {
+    int i, n = 0;
+    for (i = 0; i < self->n_views; ++i) {
+        if (self->views[i]->refs > 1) {
+            self->views[n++] = self->views[i];
+        } else {
+            KS_DECREF(self->views[i]);
+        }
+    }
+    self->n_views = n;
+    return n > 0;
+}
+
+/* Unmap the current region (if it is mapped, and the buffer is not persistent)
+ */
+static bool my_flush(ksgl_streambuffer self) {
+    if (self->persistent) {
+        return true;
+    }
+
+    /* The views would point to unmapped memory */
+    if (my_views_inuse(self)) {
+        KS_THROW(kst_Error, "Buffer cannot be flushed while views from 'alloc()' are still in use (%i of them)", self->n_views);
+        return false;
+    } else if (!self->map) {
+        return true;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, self->val);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    self->map = NULL;
+
+    return ksgl_check();
+}
+
+/* Fence the current region, and move to the next one, waiting until the GPU is done with it
+ * This is only done at the end of a frame, after the draws reading the region have been issued
+ */
+static bool my_advance(ksgl_streambuffer self) {
+    if (!my_flush(self)) {
+        return false;
+    }
+
+    /* Fence all commands using this region */
+    if (self->fences[self->region]) glDeleteSync(self->fences[self->region]);
+    self->fences[self->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    self->region = (self->region + 1) % self->n_regions;
+    if (!ksgl_fence_wait(&self->fences[self->region], &self->n_waits)) {
+        return false;
+    }
+
+    self->head = self->region * my_regionsize(self);
+    return true;
+}
+
+/* Allocate 'sz' bytes from the current region, returning the offset (or -1 and throwing an error)
+ */
+static ks_ssize_t my_alloc(ksgl_streambuffer self, ks_ssize_t sz) {
+    ks_ssize_t rsz = my_regionsize(self);
+    if (sz > rsz) {
+        KS_THROW(kst_SizeError, "Cannot allocate %i bytes, regions are only %i bytes", (int)sz, (int)rsz);
+        return -1;
+    }
+
+    ks_ssize_t off = (self->head + self->align - 1) / self->align * self->align;
+    ks_ssize_t end = (self->region + 1) * rsz;
+    if (off + sz > end) {
+        /* A fence placed now would come before the draws using this region, and the next region
+         *   may still be in use by the GPU, so there is nowhere safe to put it */
+        KS_THROW(kst_SizeError, "Cannot allocate %i bytes, only %i bytes are left in this frame's region (call 'frame()' at the end of each frame, or use a larger buffer)", (int)sz, (int)(end - off > 0 ? end - off : 0));
+        return -1;
+    }
+
+    if (!self->map && end > off) {
+        /* Map the rest of the region, which the GPU is not using (so no synchronization is needed) */
+        glBindBuffer(GL_ARRAY_BUFFER, self->val);
+        self->map = glMapBufferRange(GL_ARRAY_BUFFER, off, end - off, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!self->map) {
+            if (ksgl_check()) KS_THROW(kst_Error, "Failed to map buffer");
+            return -1;
+        }
+        self->map_offset = off;
+    }
+
+    self->head = off + sz;
+    return off;
+}
+
+
+/* C-API */
+
+/* Type Functions */
+
+static KS_TFUNC(T, free) {
+    ksgl_streambuffer self;
+    KS_ARGS("self:*", &self, ksglt_streambuffer);
+
+    if (self->val >= 0) ksgl_delete(KSGL_OBJ_BUFFER, self->val, !self->persistent);
+
+    int i;
+    for (i = 0; i < self->n_regions; ++i) {
+        ksgl_delete_sync(self->fences[i]);
+    }
+    ks_free(self->fences);
+    ks_free(self->views);
+
+    KSO_DEL(self);
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, init) {
+    ksgl_streambuffer self;
+    ks_cint size = KSGL_STREAMBUFFER_SIZE, nregions = 3, align = 16;
+    KS_ARGS("self:* ?size:cint ?nregions:cint ?align:cint", &self, ksglt_streambuffer, &size, &nregions, &align);
+
+    self->val = -1;
+    self->n_regions = 0;
+    self->fences = NULL;
+    self->region = 0;
+    self->head = 0;
+    self->map = NULL;
+    self->map_offset = 0;
+    self->persistent = ksgl_hasstorage();
+    self->n_views = self->max_views = 0;
+    self->views = NULL;
+    self->n_waits = 0;
+
+    if (size <= 0 || nregions <= 0 || align <= 0) {
+        KS_THROW(kst_Error, "'size', 'nregions' and 'align' must be positive");
+        return NULL;
+    } else if (size / nregions < align) {
+        KS_THROW(kst_Error, "Regions must be at least 'align' (%i) bytes, but 'size' is only %i bytes for %i regions", (int)align, (int)size, (int)nregions);
+        return NULL;
+    }
+    self->size = size;
+    self->align = align;
+
+    self->fences = ks_malloc(sizeof(*self->fences) * nregions);
+    if (!self->fences) {
+        KS_THROW(kst_Error, "Failed to allocate data");
+        return NULL;
+    }
+    self->n_regions = nregions;
+    int i;
+    for (i = 0; i < nregions; ++i) {
+        self->fences[i] = NULL;
+    }
+
+    /* Create buffer object */
+    self->val = ksgl_genbuffer();
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, self->val);
+    if (self->persistent) {
+        /* Map once, and write directly into GPU-visible memory */
+        glBufferStorage(GL_ARRAY_BUFFER, self->size, NULL, KSGL_STREAMBUFFER_FLAGS);
+        self->map = glMapBufferRange(GL_ARRAY_BUFFER, 0, self->size, KSGL_STREAMBUFFER_FLAGS);
+        if (!self->map) {
+            if (ksgl_check()) KS_THROW(kst_Error, "Failed to map buffer");
+            return NULL;
+        }
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, self->size, NULL, GL_STREAM_DRAW);
+    }
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, integral) {
+    ksgl_streambuffer self;
+    KS_ARGS("self:*", &self, ksglt_streambuffer);
+
+    return (kso)ks_int_new(self->val);
+}
+
+static KS_TFUNC(T, getattr) {
+    ksgl_streambuffer self;
+    ks_str attr;
+    KS_ARGS("self:* attr:*", &self, ksglt_streambuffer, &attr, kst_str);
+
+    if (ks_str_eq_c(attr, "size", 4)) {
+        return (kso)ks_int_new(self->size);
+    } else if (ks_str_eq_c(attr, "region", 6)) {
+        return (kso)ks_int_new(self->region);
+    } else if (ks_str_eq_c(attr, "persistent", 10)) {
+        return KSO_BOOL(self->persistent);
+    } else if (ks_str_eq_c(attr, "waits", 5)) {
+        return (kso)ks_int_new(self->n_waits);
+    }
+
+    KS_THROW_ATTR(self, attr);
+    return NULL;
+}
+
+static KS_TFUNC(T, bind) {
+    ksgl_streambuffer self;
+    ks_cint target = GL_ARRAY_BUFFER;
+    KS_ARGS("self:* ?target:cint", &self, ksglt_streambuffer, &target);
+
+    glBindBuffer(target, self->val);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, alloc) {
+    ksgl_streambuffer self;
+    ks_cint nbytes;
+    nx_dtype dtype = nxd_u8;
+    KS_ARGS("self:* nbytes:cint ?dtype:*", &self, ksglt_streambuffer, &nbytes, &dtype, nxt_dtype);
+
+    if (nbytes < 0 || nbytes % dtype->size != 0) {
+        KS_THROW(kst_SizeError, "Size (%i bytes) must be a non-negative multiple of the element size (%i bytes)", (int)nbytes, (int)dtype->size);
+        return NULL;
+    }
+
+    ks_ssize_t off = my_alloc(self, nbytes);
+    if (off < 0) {
+        return NULL;
+    }
+
+    /* Empty allocations at the end of a region may not have anything mapped */
+    unsigned char* ptr = self->map ? self->map + (off - self->map_offset) : NULL;
+    kso view = (kso)nx_view_newo(nxt_view, nx_make(ptr, dtype, 1, (ks_size_t[]){ nbytes / dtype->size }, NULL), (kso)self);
+    if (!view) {
+        return NULL;
+    }
+
+    if (!self->persistent) {
+        /* Keep it, so 'flush()' can tell whether it is still in use */
+        if (self->n_views >= self->max_views) {
+            /* Release views that are done with, before growing */
+            my_views_inuse(self);
+        }
+        if (self->n_views >= self->max_views) {
+            int nmax = self->max_views * 2 + 16;
+            kso* p = ks_realloc(self->views, sizeof(*self->views) * nmax);
+            if (!p) {
+                KS_DECREF(view);
+                KS_THROW(kst_Error, "Failed to allocate data");
+                return NULL;
+            }
+            self->views = p;
+            self->max_views = nmax;
+        }
+        KS_INCREF(view);
+        self->views[self->n_views++] = view;
+    }
+
+    return (kso)ks_tuple_newn(2, (kso[]) {
+        (kso)ks_int_new(off),
+        view
+    });
+}
+
+static KS_TFUNC(T, flush) {
+    ksgl_streambuffer self;
+    KS_ARGS("self:*", &self, ksglt_streambuffer);
+
+    if (!my_flush(self)) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, frame) {
+    ksgl_streambuffer self;
+    KS_ARGS("self:*", &self, ksglt_streambuffer);
+
+    if (!my_advance(self)) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+
+/* Export */
+
+ks_type ksglt_streambuffer;
+
+void _ksgl_streambuffer() {
+    ksglt_streambuffer = ks_type_new(T_NAME, kst_object, sizeof(struct ksgl_streambuffer_s), -1, "Ring of per-frame regions in one large vertex buffer, for streaming dynamic data without stalling", KS_IKV(
+        {"__free",                 ksf_wrap(T_free_, T_NAME ".__free(self)", "")},
+        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, size=16MB, nregions=3, align=16)", "Create a buffer of 'size' bytes, split into 'nregions' frame regions which are fenced and reused once the GPU is done with them. The buffer is persistently mapped if buffer storage is supported")},
+
+        {"__integral",             ksf_wrap(T_integral_, T_NAME ".__integral(self)", "Converts to an integer (the OpenGL handle)")},
+        {"__getattr",              ksf_wrap(T_getattr_, T_NAME ".__getattr(self, attr)", "")},
+
+        {"bind",                   ksf_wrap(T_bind_, T_NAME ".bind(self, target=gl.ARRAY_BUFFER)", "Bind the buffer, i.e. before setting up attributes with 'gl.VAO.attrib()' (using the offsets from 'alloc()')")},
+        {"alloc",                  ksf_wrap(T_alloc_, T_NAME ".alloc(self, nbytes, dtype=nx.uint8)", "Allocate 'nbytes' from the current region, returning a tuple of '(offset, view)', where 'view' is a writable 1D 'nx' view of 'dtype' elements. Throws a 'SizeError' if the region does not have enough space left for this frame")},
+        {"flush",                  ksf_wrap(T_flush_, T_NAME ".flush(self)", "Make writes to views visible to the GPU, which must be done before drawing. Unless the buffer is persistent (in which case, this does nothing), this throws while views from 'alloc()' are still referenced, since they would be invalid afterwards")},
+        {"frame",                  ksf_wrap(T_frame_, T_NAME ".frame(self)", "End the frame (after all draws using it have been issued), fencing the current region and moving to the next one (waiting until the GPU is done with it)")},
+    ));
+}
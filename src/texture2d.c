@@ -9,6 +9,76 @@
 
 /* Internals */
 
+/* Returns the size (in bytes) of a pixel with a given format and type, or -1 if it is not known
+ */
+static int my_pixelsize(int format, int type) {
+    int nc = -1;
+    switch (format) {
+        case GL_RED:
+        case GL_GREEN:
+        case GL_BLUE:
+        case GL_RED_INTEGER:
+        case GL_DEPTH_COMPONENT:
+        case GL_STENCIL_INDEX:
+            nc = 1;
+            break;
+        case GL_RG:
+        case GL_RG_INTEGER:
+        case GL_DEPTH_STENCIL:
+            nc = 2;
+            break;
+        case GL_RGB:
+        case GL_BGR:
+        case GL_RGB_INTEGER:
+        case GL_BGR_INTEGER:
+            nc = 3;
+            break;
+        case GL_RGBA:
+        case GL_BGRA:
+        case GL_RGBA_INTEGER:
+        case GL_BGRA_INTEGER:
+            nc = 4;
+            break;
+    }
+    if (nc < 0) return -1;
+
+    switch (type) {
+        case GL_UNSIGNED_BYTE:
+        case GL_BYTE:
+            return nc;
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+        case GL_HALF_FLOAT:
+            return 2 * nc;
+        case GL_UNSIGNED_INT:
+        case GL_INT:
+        case GL_FLOAT:
+            return 4 * nc;
+
+        /* Packed types, which hold an entire pixel */
+        case GL_UNSIGNED_BYTE_3_3_2:
+        case GL_UNSIGNED_BYTE_2_3_3_REV:
+            return 1;
+        case GL_UNSIGNED_SHORT_5_6_5:
+        case GL_UNSIGNED_SHORT_5_6_5_REV:
+        case GL_UNSIGNED_SHORT_4_4_4_4:
+        case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+        case GL_UNSIGNED_SHORT_5_5_5_1:
+        case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+            return 2;
+        case GL_UNSIGNED_INT_8_8_8_8:
+        case GL_UNSIGNED_INT_8_8_8_8_REV:
+        case GL_UNSIGNED_INT_10_10_10_2:
+        case GL_UNSIGNED_INT_2_10_10_10_REV:
+        case GL_UNSIGNED_INT_24_8:
+        case GL_UNSIGNED_INT_10F_11F_11F_REV:
+        case GL_UNSIGNED_INT_5_9_9_9_REV:
+            return 4;
+    }
+
+    return -1;
+}
+
 /* C-API */
 
 /* Type Functions */
@@ -17,7 +87,7 @@ static KS_TFUNC(T, free) {
     ksgl_texture2d self;
     KS_ARGS("self:*", &self, ksglt_texture2d);
 
-    if (self->val >= 0) glDeleteTextures(1, (GLuint[]){ self->val });
+    if (self->val >= 0) ksgl_delete(KSGL_OBJ_TEXTURE, self->val, false);
 
     KSO_DEL(self);
     return KSO_NONE;
@@ -42,12 +112,6 @@ static KS_TFUNC(T, init) {
     glGenTextures(1, &t);
     self->val = t;
 
-    /* Convert the data to its bytes equivalent */
-    ks_bytes data_bytes = kso_bytes(data);
-    if (!data_bytes) {
-        return NULL;
-    }
-
     /* Bind as the currently used texture */
     glBindTexture(GL_TEXTURE_2D, self->val);
     if (!ksgl_check()) {
@@ -66,14 +130,19 @@ static KS_TFUNC(T, init) {
             KS_THROW(kst_Error, "'width' and 'height' must be given if 'data' is given");
             return NULL;
         }
+
+        /* Get the bytes, which point into 'data' if it is a dense array */
+        struct ksgl_data bytes;
+        if (!ksgl_data_get(data, &bytes)) {
+            return NULL;
+        }
+
         /* Upload image data */
-        glTexImage2D(GL_TEXTURE_2D, 0, internalformat, width, height, 0, format, type, data_bytes->data);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalformat, width, height, 0, format, type, bytes.data);
+        ksgl_data_done(&bytes);
         glGenerateMipmap(GL_TEXTURE_2D);
     }
 
-    /* Done with the bytes */
-    KS_DECREF(data_bytes);
-
     return KSO_NONE;
 }
 
@@ -95,25 +164,27 @@ static KS_TFUNC(T, write) {
 
     if (internalformat < 0) internalformat = format;
 
-    /* Convert the data to its bytes equivalent */
-    ks_bytes data_bytes = kso_bytes(data);
-    if (!data_bytes) {
+    if (width < 0 || height < 0) {
+        KS_THROW(kst_Error, "'width' and 'height' must be given if 'data' is given");
         return NULL;
     }
 
-    if (width < 0 || height < 0) {
-        KS_THROW(kst_Error, "'width' and 'height' must be given if 'data' is given");
+    /* Get the bytes, which point into 'data' if it is a dense array */
+    struct ksgl_data bytes;
+    if (!ksgl_data_get(data, &bytes)) {
         return NULL;
     }
 
     /* Bind as the currently used texture */
     glBindTexture(GL_TEXTURE_2D, self->val);
     if (!ksgl_check()) {
+        ksgl_data_done(&bytes);
         return NULL;
     }
 
     /* Upload image data */
-    glTexImage2D(GL_TEXTURE_2D, 0, internalformat, width, height, 0, format, type, data_bytes->data);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalformat, width, height, 0, format, type, bytes.data);
+    ksgl_data_done(&bytes);
     if (!ksgl_check()) {
         return NULL;
     }
@@ -123,12 +194,57 @@ static KS_TFUNC(T, write) {
         return NULL;
     }
 
-    KS_DECREF(data_bytes);
-
     return KSO_NONE;
 }
 
 
+static KS_TFUNC(T, read_into) {
+    ksgl_texture2d self;
+    kso out;
+    ks_cint level = 0;
+    ks_cint format = GL_RGBA;
+    ks_cint type = GL_UNSIGNED_BYTE;
+    KS_ARGS("self:* out ?level:cint ?format:cint ?type:cint", &self, ksglt_texture2d, &out, &level, &format, &type);
+
+    nx_t x;
+    if (!ksgl_getout(out, &x)) {
+        return NULL;
+    }
+
+    int psz = my_pixelsize(format, type);
+    if (psz < 0) {
+        KS_THROW(kst_Error, "Unsupported format (0x%x) and type (0x%x) to read", (int)format, (int)type);
+        return NULL;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, self->val);
+    GLint w = 0, h = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &w);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &h);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    ks_ssize_t sz = x.dtype->size * nx_szprod(x.rank, x.shape);
+    if (sz != (ks_ssize_t)w * h * psz) {
+        KS_THROW(kst_SizeError, "Texture level %i is %ix%i (%i bytes), but the array is %i bytes", (int)level, (int)w, (int)h, (int)((ks_ssize_t)w * h * psz), (int)sz);
+        return NULL;
+    }
+
+    /* Rows are tightly packed in the array, and read into client memory (not a pixel buffer) */
+    GLint align = 4;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &align);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glGetTexImage(GL_TEXTURE_2D, level, format, type, x.data);
+    glPixelStorei(GL_PACK_ALIGNMENT, align);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KS_NEWREF(out);
+}
+
 static KS_TFUNC(T, bind) {
     ksgl_texture2d self;
     ks_cint idx;
@@ -172,6 +288,7 @@ void _ksgl_texture2d() {
         {"unbind",                 ksf_wrap(T_unbind_, T_NAME ".unbind(self)", "Unbind this vertex buffer object")},
     
         {"write",                  ksf_wrap(T_write_, T_NAME ".write(self, data, width, height, format=gl.RGBA, type=gl.UNSIGNED_BYTE, internalformat=-1)", "Write to the image. If 'internalformat < 0', then it is set equal to 'format'")},
+        {"read_into",              ksf_wrap(T_read_into_, T_NAME ".read_into(self, out, level=0, format=gl.RGBA, type=gl.UNSIGNED_BYTE)", "Read a mipmap level of the image directly into 'out' (a dense 'nx.array', which must be exactly the size of the level), and return 'out'")},
     
     
     ));
@@ -0,0 +1,423 @@
+/* ubo.c - gl.UBO type
+ *
+ * @author: Cade Brown <cade@kscript.org>
+ */
+#include <ksgl.h>
+
+#define T_NAME M_NAME ".UBO"
+
+
+/* Internals */
+
+/* Round 'x' up to a multiple of 'a' */
+#define ROUNDUP(x, a) (((x) + (a) - 1) / (a) * (a))
+
+/* Compute the std140 layout of a member placed at (or after) 'offset', and return the offset just
+ *   past it
+ */
+static int my_std140(struct ksgl_ubo_member* m, int offset) {
+    int align, sz;
+    if (m->rows > 1) {
+        /* Matrices are arrays of column (or row) vectors, each aligned as a 'vec4' */
+        m->mstride = 16;
+        m->astride = 16 * (m->rowmajor ? m->rows : m->cols);
+        align = 16;
+        sz = m->astride * m->size;
+    } else {
+        /* Scalars and vectors, where 'vec3' is aligned as a 'vec4' */
+        m->mstride = 0;
+        align = m->cols == 1 ? 4 : (m->cols == 2 ? 8 : 16);
+        if (m->size > 1) {
+            /* Array elements are aligned as a 'vec4' */
+            align = 16;
+            m->astride = 16;
+            sz = m->astride * m->size;
+        } else {
+            m->astride = 4 * m->cols;
+            sz = m->astride;
+        }
+    }
+
+    m->offset = ROUNDUP(offset, align);
+    return m->offset + sz;
+}
+
+/* Write 'val' into the block data for member 'm' */
+static bool my_write(ksgl_ubo self, struct ksgl_ubo_member* m, kso val) {
+    nx_t vn;
+    kso ref = NULL;
+    if (!nx_get(val, m->kind == 'f' ? nxd_F : (m->kind == 'u' ? nxd_u32 : nxd_s32), &vn, &ref)) {
+        return false;
+    }
+
+    /* Number of values per element, and number of elements */
+    int n = m->rows * m->cols;
+    ks_size_t total = nx_szprod(vn.rank, vn.shape);
+    if (total % n != 0 || total / n > m->size || total == 0) {
+        KS_THROW(kst_SizeError, "Expected %i values (or a multiple, up to %i elements) for member %R of uniform block %R", n, m->size, m->name, self->block);
+        KS_NDECREF(ref);
+        return false;
+    }
+    int count = total / n;
+
+    /* Never write past the end of the block, even if the layout is wrong */
+    int vecs = m->rowmajor ? m->rows : m->cols, veclen = m->rowmajor ? m->cols : m->rows;
+    int elsz = m->rows == 1 ? 4 * m->cols : m->mstride * (vecs - 1) + 4 * veclen;
+    if (m->offset < 0 || (ks_ssize_t)m->offset + (ks_ssize_t)m->astride * (count - 1) + elsz > self->size) {
+        KS_THROW(kst_SizeError, "Member %R of uniform block %R would be written past the end of the block (%i bytes)", m->name, self->block, self->size);
+        KS_NDECREF(ref);
+        return false;
+    }
+
+    /* Pack densely, then scatter into the block */
+    uint32_t vs[16];
+    uint32_t* v = vs;
+    if (total > 16) {
+        v = ks_malloc(sizeof(*v) * total);
+        if (!v) {
+            KS_THROW(kst_Error, "Failed to allocate data");
+            KS_NDECREF(ref);
+            return false;
+        }
+    }
+    ksgl_pack(vn, v);
+    KS_NDECREF(ref);
+
+    int e, i, j;
+    for (e = 0; e < count; ++e) {
+        unsigned char* dst = self->data + m->offset + m->astride * e;
+        uint32_t* src = v + n * e;
+        if (m->rows == 1) {
+            memcpy(dst, src, 4 * m->cols);
+        } else {
+            for (i = 0; i < m->rows; ++i) {
+                for (j = 0; j < m->cols; ++j) {
+                    /* Column-major by default, so column 'j' is one vector */
+                    int off = m->rowmajor ? (m->mstride * i + 4 * j) : (m->mstride * j + 4 * i);
+                    memcpy(dst + off, &src[i * m->cols + j], 4);
+                }
+            }
+        }
+    }
+
+    if (v != vs) ks_free(v);
+    return true;
+}
+
+/* Find a member by name */
+static struct ksgl_ubo_member* my_getmember(ksgl_ubo self, ks_str name) {
+    int i;
+    for (i = 0; i < self->n_members; ++i) {
+        if (self->members[i].name->len_b == name->len_b && memcmp(self->members[i].name->data, name->data, name->len_b) == 0) {
+            return &self->members[i];
+        }
+    }
+    return NULL;
+}
+
+/* Build the layout of the block 'b' of 'shader'
+ * Members are placed by std140 rules. Members of structures take their layout from OpenGL, since it
+ *   depends on the declaration of the structure
+ */
+static bool my_layout(ksgl_ubo self, ksgl_shader shader, struct ksgl_shader_block* b) {
+    int i, j, n = 0;
+    for (i = 0; i < shader->prog->n_uniforms; ++i) {
+        if (shader->prog->uniforms[i].block == b->index && shader->prog->uniforms[i].elem < 0) n++;
+    }
+
+    self->members = ks_malloc(sizeof(*self->members) * (n + 1));
+    if (!self->members) {
+        KS_THROW(kst_Error, "Failed to allocate data");
+        return false;
+    }
+
+    for (i = 0; i < shader->prog->n_uniforms; ++i) {
+        struct ksgl_shader_uniform* u = &shader->prog->uniforms[i];
+        if (u->block != b->index || u->elem >= 0) continue;
+        if (!u->set) {
+            KS_THROW(kst_TypeError, "Member %R of uniform block %R has an unsupported type (0x%x)", u->name, b->name, u->type);
+            return false;
+        }
+
+        /* Remove the '<block>.' prefix */
+        const char* nm = u->name->data;
+        int nl = u->name->len_b;
+        if (nl > b->name->len_b && memcmp(nm, b->name->data, b->name->len_b) == 0 && nm[b->name->len_b] == '.') {
+            nm += b->name->len_b + 1;
+            nl -= b->name->len_b + 1;
+        }
+
+        /* Insert, sorted by the offset OpenGL gives (which is declaration order) */
+        GLint props[4];
+        GLenum pnames[4] = { GL_UNIFORM_OFFSET, GL_UNIFORM_ARRAY_STRIDE, GL_UNIFORM_MATRIX_STRIDE, GL_UNIFORM_IS_ROW_MAJOR };
+        for (j = 0; j < 4; ++j) {
+            glGetActiveUniformsiv(shader->val, 1, (GLuint[]){ u->index }, pnames[j], &props[j]);
+        }
+
+        j = self->n_members++;
+        while (j > 0 && self->members[j - 1].offset > props[0]) {
+            self->members[j] = self->members[j - 1];
+            j--;
+        }
+
+        struct ksgl_ubo_member* m = &self->members[j];
+        m->name = ks_str_new(nl, nm);
+        m->type = u->type;
+        m->size = u->size;
+        m->rows = u->rows;
+        m->cols = u->cols;
+        m->kind = u->kind;
+        m->offset = props[0];
+        m->astride = props[1];
+        m->mstride = props[2];
+        m->rowmajor = props[3] != 0;
+    }
+
+    if (!ksgl_check()) {
+        return false;
+    }
+
+    /* Now, compute std140 offsets and make sure they match */
+    int offset = 0;
+    bool instruct = false;
+    for (i = 0; i < self->n_members; ++i) {
+        struct ksgl_ubo_member* m = &self->members[i];
+        if (memchr(m->name->data, '.', m->name->len_b)) {
+            /* Structure member */
+            int elsz = m->rows > 1 ? m->mstride * (m->rowmajor ? m->rows : m->cols) : 4 * m->cols;
+            offset = m->offset + (m->size > 1 ? m->astride * m->size : elsz);
+            instruct = true;
+            continue;
+        } else if (instruct) {
+            /* Structures are padded to a multiple of a 'vec4' */
+            offset = ROUNDUP(offset, 16);
+            instruct = false;
+        }
+
+        int gl_offset = m->offset, gl_astride = m->astride, gl_mstride = m->mstride;
+        offset = my_std140(m, offset);
+        if (m->offset != gl_offset) {
+            KS_THROW(kst_Error, "Uniform block %R is not laid out as std140 (member %R is at offset %i, expected %i). Declare it with 'layout(std140)'", b->name, m->name, gl_offset, m->offset);
+            return false;
+        } else if ((m->size > 1 && m->astride != gl_astride) || (m->rows > 1 && m->mstride != gl_mstride)) {
+            /* Strides are only meaningful for arrays and matrices (OpenGL reports 0 otherwise) */
+            KS_THROW(kst_Error, "Uniform block %R is not laid out as std140 (member %R has strides %i/%i, expected %i/%i). Declare it with 'layout(std140)'", b->name, m->name, gl_astride, gl_mstride, m->astride, m->mstride);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/* C-API */
+
+bool ksgl_ubo_pack(ksgl_ubo self, kso vals) {
+    if (kso_issub(vals->type, kst_dict)) {
+        /* Pack each member that was given */
+        ks_list keys = ks_list_newi(vals);
+        if (!keys) {
+            return false;
+        }
+
+        int i;
+        for (i = 0; i < keys->len; ++i) {
+            kso key = keys->elems[i];
+            if (!kso_issub(key->type, kst_str)) {
+                KS_THROW(kst_TypeError, "Expected keys to be 'str' objects, but got '%T' object", key);
+                KS_DECREF(keys);
+                return false;
+            }
+
+            struct ksgl_ubo_member* m = my_getmember(self, (ks_str)key);
+            if (!m) {
+                KS_THROW(kst_KeyError, "Uniform block %R has no member %R", self->block, key);
+                KS_DECREF(keys);
+                return false;
+            }
+
+            kso val = ks_dict_get((ks_dict)vals, key);
+            if (!val) {
+                KS_DECREF(keys);
+                return false;
+            }
+
+            bool ok = my_write(self, m, val);
+            KS_DECREF(val);
+            if (!ok) {
+                KS_DECREF(keys);
+                return false;
+            }
+        }
+
+        KS_DECREF(keys);
+    } else {
+        /* Raw data, already laid out */
+        struct ksgl_data bytes;
+        if (!ksgl_data_get(vals, &bytes)) {
+            return false;
+        }
+        if (bytes.len > self->size) {
+            KS_THROW(kst_SizeError, "Data is %i bytes, but uniform block %R is only %i bytes", (int)bytes.len, self->block, self->size);
+            ksgl_data_done(&bytes);
+            return false;
+        }
+
+        memcpy(self->data, bytes.data, bytes.len);
+        ksgl_data_done(&bytes);
+    }
+
+    return true;
+}
+
+/* Type Functions */
+
+static KS_TFUNC(T, free) {
+    ksgl_ubo self;
+    KS_ARGS("self:*", &self, ksglt_ubo);
+
+    if (self->val >= 0) ksgl_delete(KSGL_OBJ_BUFFER, self->val, true);
+
+    int i;
+    for (i = 0; i < self->n_members; ++i) {
+        KS_DECREF(self->members[i].name);
+    }
+    ks_free(self->members);
+    ks_free(self->data);
+    KS_NDECREF(self->block);
+
+    KSO_DEL(self);
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, init) {
+    ksgl_ubo self;
+    ksgl_shader shader;
+    ks_str block;
+    ks_cint usage = GL_DYNAMIC_DRAW;
+    KS_ARGS("self:* shader:* block:* ?usage:cint", &self, ksglt_ubo, &shader, ksglt_shader, &block, kst_str, &usage);
+
+    self->val = -1;
+    self->n_members = 0;
+    self->members = NULL;
+    self->data = NULL;
+    KS_INCREF(block);
+    self->block = block;
+
+    if (!ksgl_shader_ready(shader)) {
+        return NULL;
+    }
+
+    struct ksgl_shader_block* b = ksgl_shader_getblock(shader, block);
+    if (!b) {
+        KS_THROW(kst_Error, "Unknown uniform block %R", block);
+        return NULL;
+    }
+
+    if (!my_layout(self, shader, b)) {
+        return NULL;
+    }
+
+    self->size = b->size;
+    self->data = ks_malloc(self->size + 1);
+    if (!self->data) {
+        KS_THROW(kst_Error, "Failed to allocate data");
+        return NULL;
+    }
+    memset(self->data, 0, self->size);
+
+    /* Create buffer object */
+    self->val = ksgl_genbuffer();
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, self->val);
+    glBufferData(GL_UNIFORM_BUFFER, self->size, self->data, usage);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, integral) {
+    ksgl_ubo self;
+    KS_ARGS("self:*", &self, ksglt_ubo);
+
+    return (kso)ks_int_new(self->val);
+}
+
+static KS_TFUNC(T, getattr) {
+    ksgl_ubo self;
+    ks_str attr;
+    KS_ARGS("self:* attr:*", &self, ksglt_ubo, &attr, kst_str);
+
+    if (ks_str_eq_c(attr, "size", 4)) {
+        return (kso)ks_int_new(self->size);
+    } else if (ks_str_eq_c(attr, "block", 5)) {
+        return KS_NEWREF(self->block);
+    } else if (ks_str_eq_c(attr, "offsets", 7)) {
+        ks_dict res = ks_dict_new(NULL);
+        int i;
+        for (i = 0; i < self->n_members; ++i) {
+            ks_int v = ks_int_new(self->members[i].offset);
+            ks_dict_set(res, (kso)self->members[i].name, (kso)v);
+            KS_DECREF(v);
+        }
+        return (kso)res;
+    }
+
+    KS_THROW_ATTR(self, attr);
+    return NULL;
+}
+
+static KS_TFUNC(T, bind) {
+    ksgl_ubo self;
+    ks_cint binding;
+    KS_ARGS("self:* binding:cint", &self, ksglt_ubo, &binding);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, self->val);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, write) {
+    ksgl_ubo self;
+    kso vals;
+    KS_ARGS("self:* vals", &self, ksglt_ubo, &vals);
+
+    if (!ksgl_ubo_pack(self, vals)) {
+        return NULL;
+    }
+
+    /* Upload the entire block at once */
+    glBindBuffer(GL_UNIFORM_BUFFER, self->val);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, self->size, self->data);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+
+/* Export */
+
+ks_type ksglt_ubo;
+
+void _ksgl_ubo() {
+    ksglt_ubo = ks_type_new(T_NAME, kst_object, sizeof(struct ksgl_ubo_s), -1, "OpenGL uniform buffer object (UBO), laid out for a uniform block", KS_IKV(
+        {"__free",                 ksf_wrap(T_free_, T_NAME ".__free(self)", "")},
+        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, shader, block, usage=gl.DYNAMIC_DRAW)", "Create a buffer for the uniform block named 'block' in 'shader', which must be declared 'layout(std140)'")},
+
+        {"__integral",             ksf_wrap(T_integral_, T_NAME ".__integral(self)", "Converts to an integer (the OpenGL handle)")},
+        {"__getattr",              ksf_wrap(T_getattr_, T_NAME ".__getattr(self, attr)", "")},
+
+        {"bind",                   ksf_wrap(T_bind_, T_NAME ".bind(self, binding)", "Bind this buffer to the uniform buffer binding point 'binding' (see 'gl.Shader.block_binding()')")},
+        {"write",                  ksf_wrap(T_write_, T_NAME ".write(self, vals)", "Write members of the block from a dict of names to values, or raw std140 data from a bytes-like object, and upload the block")},
+    ));
+}
@@ -0,0 +1,98 @@
+/* uniform.c - gl.Uniform type
+ *
+ * @author: Cade Brown <cade@kscript.org>
+ */
+#include <ksgl.h>
+
+#define T_NAME M_NAME ".Uniform"
+
+
+/* Internals */
+
+/* C-API */
+
+/* Type Functions */
+
+static KS_TFUNC(T, free) {
+    ksgl_uniform self;
+    KS_ARGS("self:*", &self, ksglt_uniform);
+
+    KS_NDECREF(self->shader);
+
+    KSO_DEL(self);
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, init) {
+    ksgl_uniform self;
+    KS_ARGS("self:*", &self, ksglt_uniform);
+
+    KS_THROW(kst_TypeError, "'%T' cannot be created directly, use 'gl.Shader.handle()'", self);
+    return NULL;
+}
+
+static KS_TFUNC(T, str) {
+    ksgl_uniform self;
+    KS_ARGS("self:*", &self, ksglt_uniform);
+
+    return (kso)ks_fmt("<%T name=%R, loc=%i>", self, self->val->name, self->val->loc);
+}
+
+static KS_TFUNC(T, integral) {
+    ksgl_uniform self;
+    KS_ARGS("self:*", &self, ksglt_uniform);
+
+    return (kso)ks_int_new(self->val->loc);
+}
+
+static KS_TFUNC(T, getattr) {
+    ksgl_uniform self;
+    ks_str attr;
+    KS_ARGS("self:* attr:*", &self, ksglt_uniform, &attr, kst_str);
+
+    if (ks_str_eq_c(attr, "name", 4)) {
+        return KS_NEWREF(self->val->name);
+    } else if (ks_str_eq_c(attr, "loc", 3)) {
+        return (kso)ks_int_new(self->val->loc);
+    } else if (ks_str_eq_c(attr, "type", 4)) {
+        return (kso)ks_int_new(self->val->type);
+    } else if (ks_str_eq_c(attr, "size", 4)) {
+        return (kso)ks_int_new(self->val->size);
+    } else if (ks_str_eq_c(attr, "shader", 6)) {
+        return KS_NEWREF(self->shader);
+    }
+
+    KS_THROW_ATTR(self, attr);
+    return NULL;
+}
+
+static KS_TFUNC(T, set) {
+    ksgl_uniform self;
+    kso val;
+    KS_ARGS("self:* val", &self, ksglt_uniform, &val);
+
+    /* Location, type and setter were all resolved when the handle was created */
+    if (!ksgl_shader_upload(self->shader, self->val, val)) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+
+/* Export */
+
+ks_type ksglt_uniform;
+
+void _ksgl_uniform() {
+    ksglt_uniform = ks_type_new(T_NAME, kst_object, sizeof(struct ksgl_uniform_s), -1, "OpenGL shader uniform handle", KS_IKV(
+        {"__free",                 ksf_wrap(T_free_, T_NAME ".__free(self)", "")},
+        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self)", "")},
+        {"__str",                  ksf_wrap(T_str_, T_NAME ".__str(self)", "")},
+        {"__repr",                 ksf_wrap(T_str_, T_NAME ".__repr(self)", "")},
+        {"__integral",             ksf_wrap(T_integral_, T_NAME ".__integral(self)", "Converts to an integer (the uniform location)")},
+        {"__getattr",              ksf_wrap(T_getattr_, T_NAME ".__getattr(self, attr)", "")},
+
+        {"set",                    ksf_wrap(T_set_, T_NAME ".set(self, val)", "Set the uniform to a given value (uploading it to its shader, even if another one is in use)")},
+    ));
+}
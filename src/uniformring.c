@@ -0,0 +1,211 @@
+/* uniformring.c - gl.UniformRing type
+ *
+ * @author: Cade Brown <cade@kscript.org>
+ */
+#include <ksgl.h>
+
+#define T_NAME M_NAME ".UniformRing"
+
+
+/* Internals */
+
+/* Default size of the buffer */
+#define KSGL_UNIFORMRING_SIZE (4 * 1024 * 1024)
+
+/* Allocate 'sz' bytes from the ring, returning the offset (or -1 and throwing an error)
+ * When the current region is full, it is fenced and the next region is used, once the GPU is done
+ *   with it
+ */
+static int my_alloc(ksgl_uniformring self, int sz) {
+    /* Regions start on a multiple of the alignment, so the first slice of each one can be bound */
+    int rsz = self->size / self->n_regions / self->align * self->align;
+    if (sz > rsz) {
+        KS_THROW(kst_SizeError, "Cannot allocate %i bytes, regions are only %i bytes", sz, rsz);
+        return -1;
+    }
+
+    int off = (self->head + self->align - 1) / self->align * self->align;
+    if (off + sz > (self->region + 1) * rsz) {
+        /* Fence all commands using this region */
+        self->fences[self->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        /* Move to the next region, waiting until the GPU is done reading it */
+        self->region = (self->region + 1) % self->n_regions;
+        if (!ksgl_fence_wait(&self->fences[self->region], &self->n_waits)) {
+            return -1;
+        }
+
+        off = self->region * rsz;
+    }
+
+    self->head = off + sz;
+    return off;
+}
+
+
+/* C-API */
+
+/* Type Functions */
+
+static KS_TFUNC(T, free) {
+    ksgl_uniformring self;
+    KS_ARGS("self:*", &self, ksglt_uniformring);
+
+    if (self->val >= 0) ksgl_delete(KSGL_OBJ_BUFFER, self->val, true);
+
+    int i;
+    for (i = 0; i < self->n_regions; ++i) {
+        ksgl_delete_sync(self->fences[i]);
+    }
+    ks_free(self->fences);
+
+    KSO_DEL(self);
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, init) {
+    ksgl_uniformring self;
+    ks_cint size = KSGL_UNIFORMRING_SIZE, nregions = 3;
+    KS_ARGS("self:* ?size:cint ?nregions:cint", &self, ksglt_uniformring, &size, &nregions);
+
+    self->val = -1;
+    self->n_regions = 0;
+    self->fences = NULL;
+    self->region = self->head = 0;
+    self->n_waits = 0;
+
+    if (size <= 0 || nregions <= 0) {
+        KS_THROW(kst_Error, "'size' and 'nregions' must be positive");
+        return NULL;
+    }
+
+    GLint align = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    self->align = align > 0 ? align : 1;
+    self->size = size;
+    if (size / nregions < self->align) {
+        KS_THROW(kst_Error, "Regions must be at least %i bytes, but 'size' is only %i bytes for %i regions", self->align, (int)size, (int)nregions);
+        return NULL;
+    }
+
+    self->fences = ks_malloc(sizeof(*self->fences) * nregions);
+    if (!self->fences) {
+        KS_THROW(kst_Error, "Failed to allocate data");
+        return NULL;
+    }
+    self->n_regions = nregions;
+    int i;
+    for (i = 0; i < nregions; ++i) {
+        self->fences[i] = NULL;
+    }
+
+    /* Create buffer object */
+    self->val = ksgl_genbuffer();
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, self->val);
+    glBufferData(GL_UNIFORM_BUFFER, self->size, NULL, GL_STREAM_DRAW);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, integral) {
+    ksgl_uniformring self;
+    KS_ARGS("self:*", &self, ksglt_uniformring);
+
+    return (kso)ks_int_new(self->val);
+}
+
+static KS_TFUNC(T, getattr) {
+    ksgl_uniformring self;
+    ks_str attr;
+    KS_ARGS("self:* attr:*", &self, ksglt_uniformring, &attr, kst_str);
+
+    if (ks_str_eq_c(attr, "size", 4)) {
+        return (kso)ks_int_new(self->size);
+    } else if (ks_str_eq_c(attr, "align", 5)) {
+        return (kso)ks_int_new(self->align);
+    } else if (ks_str_eq_c(attr, "waits", 5)) {
+        return (kso)ks_int_new(self->n_waits);
+    }
+
+    KS_THROW_ATTR(self, attr);
+    return NULL;
+}
+
+static KS_TFUNC(T, push) {
+    ksgl_uniformring self;
+    ks_cint binding;
+    kso data;
+    ksgl_ubo ubo = NULL;
+    KS_ARGS("self:* binding:cint data ?ubo:*", &self, ksglt_uniformring, &binding, &data, &ubo, ksglt_ubo);
+
+    /* Find the bytes to write */
+    const void* src;
+    int sz;
+    struct ksgl_data bytes = { NULL, 0, NULL };
+    bool hasbytes = false;
+    if (ubo) {
+        /* Lay out with the block, as 'gl.UBO.write()' does */
+        if (!ksgl_ubo_pack(ubo, data)) {
+            return NULL;
+        }
+        src = ubo->data;
+        sz = ubo->size;
+    } else {
+        if (!ksgl_data_get(data, &bytes)) {
+            return NULL;
+        }
+        hasbytes = true;
+        src = bytes.data;
+        sz = bytes.len;
+    }
+
+    int off = my_alloc(self, sz);
+    if (off < 0) {
+        if (hasbytes) ksgl_data_done(&bytes);
+        return NULL;
+    }
+
+    /* The region is not in use by the GPU, so no synchronization is needed */
+    glBindBuffer(GL_UNIFORM_BUFFER, self->val);
+    void* dst = glMapBufferRange(GL_UNIFORM_BUFFER, off, sz, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!dst) {
+        if (hasbytes) ksgl_data_done(&bytes);
+        if (ksgl_check()) KS_THROW(kst_Error, "Failed to map uniform buffer");
+        return NULL;
+    }
+    memcpy(dst, src, sz);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    if (hasbytes) ksgl_data_done(&bytes);
+
+    /* Bind just this slice */
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, self->val, off, sz);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return (kso)ks_int_new(off);
+}
+
+
+/* Export */
+
+ks_type ksglt_uniformring;
+
+void _ksgl_uniformring() {
+    ksglt_uniformring = ks_type_new(T_NAME, kst_object, sizeof(struct ksgl_uniformring_s), -1, "Ring of per-draw uniform blocks, suballocated from one uniform buffer", KS_IKV(
+        {"__free",                 ksf_wrap(T_free_, T_NAME ".__free(self)", "")},
+        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, size=4MB, nregions=3)", "Create a ring of 'size' bytes, split into 'nregions' regions which are fenced and reused once the GPU is done with them")},
+
+        {"__integral",             ksf_wrap(T_integral_, T_NAME ".__integral(self)", "Converts to an integer (the OpenGL handle)")},
+        {"__getattr",              ksf_wrap(T_getattr_, T_NAME ".__getattr(self, attr)", "")},
+
+        {"push",                   ksf_wrap(T_push_, T_NAME ".push(self, binding, data, ubo=none)", "Write 'data' into the next slice of the ring and bind that slice to the uniform buffer binding point 'binding', returning the offset. If 'ubo' is given, 'data' is laid out as it is in 'gl.UBO.write()'")},
+    ));
+}
@@ -4,6 +4,8 @@
  */
 #include <ksgl.h>
 
+#include <time.h>
+
 
 bool ksgl_check() {
     int rc = glGetError();
@@ -16,6 +18,222 @@ bool ksgl_check() {
 }
 
 
+bool ksgl_version(int major, int minor) {
+    return gl3wIsSupported(major, minor);
+}
+
+bool ksgl_version_update() {
+#ifdef KSGL_GLFW
+    if (gl3wInit2((GL3WGetProcAddressProc)glfwGetProcAddress) != GL3W_OK || !gl3wIsSupported(3, 3)) {
+        KS_THROW(kst_Error, "Failed to initialize OpenGL (requires at least v3.3)");
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool ksgl_hasext(const char* name) {
+    GLint n = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+
+    GLint i;
+    for (i = 0; i < n; ++i) {
+        const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (ext && strcmp(ext, name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ksgl_hasstorage() {
+    /* Not cached, since it depends on the current context */
+    return glBufferStorage && (ksgl_version(4, 4) || ksgl_hasext("GL_ARB_buffer_storage"));
+}
+
+void* ksgl_context() {
+#ifdef KSGL_GLFW
+    return glfwGetCurrentContext();
+#else
+    return NULL;
+#endif
+}
+
+double ksgl_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* Objects queued for deletion, and pooled buffer names, for a single context
+ * Names are only meaningful in the context they were created in, so each context has its own
+ */
+struct my_queue {
+
+    /* Context the names belong to (or NULL, for objects freed while no context was current) */
+    void* ctx;
+
+    /* Names queued for deletion, for each kind of object (except sync objects, which are in 'syncs') */
+    int ndelete[KSGL_OBJ_N], maxdelete[KSGL_OBJ_N];
+    GLuint* del[KSGL_OBJ_N];
+    GLsync* syncs;
+
+    /* Buffer names queued to be recycled, and the pool of recycled names */
+    int nrecycle, maxrecycle;
+    GLuint* recycle;
+    int npool, maxpool;
+    GLuint* pool;
+
+};
+
+/* Queues for each context that has had objects freed */
+static int my_nqueues = 0;
+static struct my_queue* my_queues = NULL;
+
+/* Maximum number of buffer names pooled per context */
+static ks_ssize_t my_poolmax = 0;
+
+
+/* Return the queue for 'ctx', creating it if 'create' is true (or NULL if it does not exist) */
+static struct my_queue* my_getqueue(void* ctx, bool create) {
+    int i;
+    for (i = 0; i < my_nqueues; ++i) {
+        if (my_queues[i].ctx == ctx) return &my_queues[i];
+    }
+    if (!create) return NULL;
+
+    struct my_queue* p = ks_realloc(my_queues, sizeof(*my_queues) * (my_nqueues + 1));
+    if (!p) return NULL;
+    my_queues = p;
+
+    struct my_queue* q = &my_queues[my_nqueues++];
+    memset(q, 0, sizeof(*q));
+    q->ctx = ctx;
+    return q;
+}
+
+/* Push 'name' to a dynamic array of names, returning whether it succeeded */
+static bool my_pushname(GLuint** arr, int* n, int* max, GLuint name) {
+    if (*n >= *max) {
+        int nmax = *max * 2 + 16;
+        GLuint* p = ks_realloc(*arr, sizeof(**arr) * nmax);
+        if (!p) return false;
+        *arr = p;
+        *max = nmax;
+    }
+
+    (*arr)[(*n)++] = name;
+    return true;
+}
+
+void ksgl_delete(int kind, GLuint name, bool recycle) {
+    /* Objects belong to the context that is current when they are freed (if this fails, which is only when
+     *   out of memory, the object is leaked, rather than deleted at an unsafe point or from the wrong context)
+     */
+    struct my_queue* q = my_getqueue(ksgl_context(), true);
+    if (!q) return;
+
+    if (recycle && kind == KSGL_OBJ_BUFFER && my_poolmax > 0) {
+        if (my_pushname(&q->recycle, &q->nrecycle, &q->maxrecycle, name)) return;
+    }
+
+    my_pushname(&q->del[kind], &q->ndelete[kind], &q->maxdelete[kind], name);
+}
+
+void ksgl_delete_sync(GLsync fence) {
+    if (!fence) return;
+
+    struct my_queue* q = my_getqueue(ksgl_context(), true);
+    if (!q) return;
+
+    int* n = &q->ndelete[KSGL_OBJ_SYNC], *max = &q->maxdelete[KSGL_OBJ_SYNC];
+    if (*n >= *max) {
+        int nmax = *max * 2 + 16;
+        GLsync* p = ks_realloc(q->syncs, sizeof(*q->syncs) * nmax);
+        if (!p) return;
+        q->syncs = p;
+        *max = nmax;
+    }
+
+    q->syncs[(*n)++] = fence;
+}
+
+bool ksgl_delete_flush() {
+    struct my_queue* q = my_getqueue(ksgl_context(), false);
+    if (!q || !q->ctx) return true;
+
+    int i;
+
+    /* Release the storage of recycled buffers, and keep their names (unless the pool is full) */
+    for (i = 0; i < q->nrecycle; ++i) {
+        GLuint name = q->recycle[i];
+        if (q->npool < my_poolmax && my_pushname(&q->pool, &q->npool, &q->maxpool, name)) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+            glBufferData(GL_COPY_WRITE_BUFFER, 0, NULL, GL_STATIC_DRAW);
+        } else {
+            my_pushname(&q->del[KSGL_OBJ_BUFFER], &q->ndelete[KSGL_OBJ_BUFFER], &q->maxdelete[KSGL_OBJ_BUFFER], name);
+        }
+    }
+    q->nrecycle = 0;
+
+    /* Shrink the pool, if its maximum was lowered */
+    while (q->npool > my_poolmax) {
+        my_pushname(&q->del[KSGL_OBJ_BUFFER], &q->ndelete[KSGL_OBJ_BUFFER], &q->maxdelete[KSGL_OBJ_BUFFER], q->pool[--q->npool]);
+    }
+
+    if (q->ndelete[KSGL_OBJ_BUFFER] > 0) glDeleteBuffers(q->ndelete[KSGL_OBJ_BUFFER], q->del[KSGL_OBJ_BUFFER]);
+    if (q->ndelete[KSGL_OBJ_TEXTURE] > 0) glDeleteTextures(q->ndelete[KSGL_OBJ_TEXTURE], q->del[KSGL_OBJ_TEXTURE]);
+    if (q->ndelete[KSGL_OBJ_VERTEXARRAY] > 0) glDeleteVertexArrays(q->ndelete[KSGL_OBJ_VERTEXARRAY], q->del[KSGL_OBJ_VERTEXARRAY]);
+    for (i = 0; i < q->ndelete[KSGL_OBJ_PROGRAM]; ++i) {
+        glDeleteProgram(q->del[KSGL_OBJ_PROGRAM][i]);
+    }
+    for (i = 0; i < q->ndelete[KSGL_OBJ_SHADER]; ++i) {
+        glDeleteShader(q->del[KSGL_OBJ_SHADER][i]);
+    }
+    for (i = 0; i < q->ndelete[KSGL_OBJ_SYNC]; ++i) {
+        glDeleteSync(q->syncs[i]);
+    }
+
+    for (i = 0; i < KSGL_OBJ_N; ++i) {
+        q->ndelete[i] = 0;
+    }
+
+    return ksgl_check();
+}
+
+void ksgl_delete_drop(void* ctx) {
+    struct my_queue* q = my_getqueue(ctx, false);
+    if (!q) return;
+
+    int i;
+    for (i = 0; i < KSGL_OBJ_N; ++i) {
+        ks_free(q->del[i]);
+    }
+    ks_free(q->syncs);
+    ks_free(q->recycle);
+    ks_free(q->pool);
+
+    *q = my_queues[--my_nqueues];
+}
+
+void ksgl_pool_setmax(ks_ssize_t max) {
+    /* Pools are shrunk at the next flush of each context, since names can only be deleted from their own */
+    my_poolmax = max < 0 ? 0 : max;
+}
+
+GLuint ksgl_genbuffer() {
+    struct my_queue* q = my_getqueue(ksgl_context(), false);
+    if (q && q->npool > 0) {
+        return q->pool[--q->npool];
+    }
+
+    GLuint t;
+    glGenBuffers(1, &t);
+    return t;
+}
+
 bool ksgl_getcolor(int nargs, kso* args, ks_cfloat* out) {
     /* Default alpha to 1.0 */
     out[3] = 1.0;
@@ -37,5 +255,149 @@ bool ksgl_getcolor(int nargs, kso* args, ks_cfloat* out) {
     return true;
 }
 
+bool ksgl_contig(nx_t x) {
+    ks_ssize_t st = x.dtype->size;
+    int i;
+    for (i = x.rank - 1; i >= 0; --i) {
+        if (x.shape[i] != 1 && x.strides[i] != st) {
+            return false;
+        }
+        st *= x.shape[i];
+    }
 
+    return true;
+}
 
+/* Recursive implementation of 'ksgl_pack()', which advances 'out' */
+static void my_pack(int rank, ks_size_t* shape, ks_ssize_t* strides, int sz, unsigned char* data, unsigned char** out) {
+    if (rank == 0) {
+        memcpy(*out, data, sz);
+        *out += sz;
+        return;
+    }
+
+    ks_size_t i;
+    for (i = 0; i < shape[0]; ++i) {
+        my_pack(rank - 1, shape + 1, strides + 1, sz, data + strides[0] * i, out);
+    }
+}
+
+void ksgl_pack(nx_t x, void* out) {
+    unsigned char* p = out;
+    my_pack(x.rank, x.shape, x.strides, x.dtype->size, (unsigned char*)x.data, &p);
+}
+
+/* Scratch buffer for packing strided arrays, which is kept between uploads unless it grows
+ *   past 'KSGL_SCRATCH_KEEP' bytes
+ */
+#define KSGL_SCRATCH_KEEP (64 * 1024 * 1024)
+static void* my_scratch = NULL;
+static ks_size_t my_scratch_len = 0;
+
+bool ksgl_getout(kso obj, nx_t* out) {
+    if (!kso_issub(obj->type, nxt_array) && !kso_issub(obj->type, nxt_view)) {
+        KS_THROW(kst_TypeError, "Expected an 'nx.array' to read into, but got '%T' object", obj);
+        return false;
+    }
+
+    kso ref = NULL;
+    if (!nx_get(obj, NULL, out, &ref)) {
+        return false;
+    }
+    if (ref) {
+        /* A temporary was made, so writes would not reach 'obj' */
+        KS_DECREF(ref);
+        KS_THROW(kst_TypeError, "Cannot read into '%T' object directly", obj);
+        return false;
+    }
+
+    if (!ksgl_contig(*out)) {
+        KS_THROW(kst_Error, "Array to read into must be dense and row-major");
+        return false;
+    }
+
+    return true;
+}
+
+bool ksgl_data_get(kso obj, struct ksgl_data* out) {
+    if (kso_issub(obj->type, nxt_array) || kso_issub(obj->type, nxt_view)) {
+        nx_t x;
+        kso ref = NULL;
+        if (!nx_get(obj, NULL, &x, &ref)) {
+            return false;
+        }
+
+        out->len = x.dtype->size * nx_szprod(x.rank, x.shape);
+        if (ksgl_contig(x)) {
+            /* Use the array's data directly */
+            out->data = x.data;
+            out->ref = ref ? ref : obj;
+            if (!ref) KS_INCREF(obj);
+            return true;
+        }
+
+        /* Pack into the scratch buffer */
+        if (out->len > my_scratch_len) {
+            void* p = ks_realloc(my_scratch, out->len);
+            if (!p) {
+                KS_NDECREF(ref);
+                KS_THROW(kst_Error, "Failed to allocate data");
+                return false;
+            }
+            my_scratch = p;
+            my_scratch_len = out->len;
+        }
+        ksgl_pack(x, my_scratch);
+        KS_NDECREF(ref);
+
+        out->data = my_scratch;
+        out->ref = NULL;
+        return true;
+    }
+
+    ks_bytes b = kso_bytes(obj);
+    if (!b) {
+        return false;
+    }
+
+    out->data = b->data;
+    out->len = b->len_b;
+    out->ref = (kso)b;
+    return true;
+}
+
+void ksgl_data_done(struct ksgl_data* d) {
+    if (d->ref) {
+        KS_DECREF(d->ref);
+        d->ref = NULL;
+    } else if (my_scratch_len > KSGL_SCRATCH_KEEP) {
+        /* Don't hold on to huge buffers */
+        ks_free(my_scratch);
+        my_scratch = NULL;
+        my_scratch_len = 0;
+    }
+}
+
+bool ksgl_fence_wait(GLsync* fence, ks_cint* nwaits) {
+    if (!*fence) {
+        return true;
+    }
+
+    /* Poll first, to see if it has already been signaled */
+    GLenum rc = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (rc == GL_TIMEOUT_EXPIRED) {
+        if (nwaits) (*nwaits)++;
+        do {
+            rc = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        } while (rc == GL_TIMEOUT_EXPIRED);
+    }
+
+    glDeleteSync(*fence);
+    *fence = NULL;
+
+    if (rc == GL_WAIT_FAILED) {
+        KS_THROW(kst_Error, "Waiting for OpenGL fence failed");
+        return false;
+    }
+    return true;
+}
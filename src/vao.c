@@ -9,6 +9,98 @@
 
 /* Internals */
 
+/* Parsed entry of a vertex layout */
+struct my_attrib {
+    kso name;
+    int size, type, normalize;
+    ks_ssize_t offset;
+};
+
+/* Return the size (in bytes) of an attribute with 'size' components of 'type', or -1 if it is not
+ *   a valid attribute type
+ */
+static int my_attribsize(int type, int size) {
+    switch (type) {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return size;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:
+            return 2 * size;
+        case GL_INT:
+        case GL_UNSIGNED_INT:
+        case GL_FLOAT:
+        case GL_FIXED:
+            return 4 * size;
+        case GL_DOUBLE:
+            return 8 * size;
+        /* Packed types, where all components fit in 4 bytes */
+        case GL_INT_2_10_10_10_REV:
+        case GL_UNSIGNED_INT_2_10_10_10_REV:
+        case GL_UNSIGNED_INT_10F_11F_11F_REV:
+            return 4;
+    }
+
+    return -1;
+}
+
+/* Returns whether 'type' is an integer type, which is read as integers (unless normalized) */
+static bool my_isint(int type) {
+    return type == GL_BYTE || type == GL_UNSIGNED_BYTE || type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_INT || type == GL_UNSIGNED_INT;
+}
+
+/* Parse an entry '(name, size, type, normalize=false)' of a vertex layout
+ */
+static bool my_getattrib(kso obj, struct my_attrib* out) {
+    ks_list ent = ks_list_newi(obj);
+    if (!ent) {
+        return false;
+    } else if (ent->len < 3 || ent->len > 4) {
+        KS_THROW(kst_Error, "Expected layout entries to be '(name, size, type)' or '(name, size, type, normalize)', but got %R", obj);
+        KS_DECREF(ent);
+        return false;
+    }
+
+    ks_cint size, type, normalize = 0;
+    if (!kso_get_ci(ent->elems[1], &size) || !kso_get_ci(ent->elems[2], &type) || (ent->len > 3 && !kso_get_ci(ent->elems[3], &normalize))) {
+        KS_DECREF(ent);
+        return false;
+    }
+
+    out->name = ent->elems[0];
+    KS_INCREF(out->name);
+    KS_DECREF(ent);
+
+    if (size < 1 || size > 4) {
+        KS_THROW(kst_Error, "Attribute %R must have 1 to 4 components, but got %i", out->name, (int)size);
+        KS_DECREF(out->name);
+        return false;
+    } else if (my_attribsize(type, size) < 0) {
+        KS_THROW(kst_Error, "Attribute %R has invalid type %i", out->name, (int)type);
+        KS_DECREF(out->name);
+        return false;
+    } else if ((type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV) && size != 4) {
+        KS_THROW(kst_Error, "Attribute %R has a packed 2_10_10_10 type, so it must have 4 components, but got %i", out->name, (int)size);
+        KS_DECREF(out->name);
+        return false;
+    } else if (type == GL_UNSIGNED_INT_10F_11F_11F_REV && size != 3) {
+        KS_THROW(kst_Error, "Attribute %R has a packed 10F_11F_11F type, so it must have 3 components, but got %i", out->name, (int)size);
+        KS_DECREF(out->name);
+        return false;
+    } else if (type == GL_DOUBLE && !ksgl_version(4, 1) && !ksgl_hasext("GL_ARB_vertex_attrib_64bit")) {
+        KS_THROW(kst_Error, "Attribute %R is 'gl.DOUBLE', which requires OpenGL v4.1", out->name);
+        KS_DECREF(out->name);
+        return false;
+    }
+
+    out->size = size;
+    out->type = type;
+    out->normalize = normalize != 0;
+    return true;
+}
+
+
 /* C-API */
 
 /* Type Functions */
@@ -17,7 +109,7 @@ static KS_TFUNC(T, free) {
     ksgl_vao self;
     KS_ARGS("self:*", &self, ksglt_vao);
 
-    if (self->val >= 0) glDeleteVertexArrays(1, (GLuint[]){ self->val });
+    if (self->val >= 0) ksgl_delete(KSGL_OBJ_VERTEXARRAY, self->val, false);
 
     KSO_DEL(self);
     return KSO_NONE;
@@ -28,6 +120,8 @@ static KS_TFUNC(T, init) {
     ksgl_vao self;
     KS_ARGS("self:*", &self, ksglt_vao);
 
+    self->n_layout = 0;
+
     /* Create buffer object */
     GLuint t;
     glGenVertexArrays(1, &t);
@@ -83,6 +177,101 @@ static KS_TFUNC(T, attrib) {
     return KSO_NONE;
 }
 
+static KS_TFUNC(T, layout) {
+    ksgl_vao self;
+    kso fmt, vbo = KSO_NONE;
+    ks_cint divisor = 0, first = -1, offset = 0;
+    KS_ARGS("self:* fmt ?vbo ?divisor:cint ?first:cint ?offset:cint", &self, ksglt_vao, &fmt, &vbo, &divisor, &first, &offset);
+
+    if (first < 0) first = self->n_layout;
+
+    /* Buffer the attributes come from (default: the currently bound one) */
+    ks_cint buf = -1;
+    if (kso_issub(vbo->type, ksglt_vbo)) {
+        buf = ((ksgl_vbo)vbo)->val;
+    } else if (kso_issub(vbo->type, ksglt_streambuffer)) {
+        buf = ((ksgl_streambuffer)vbo)->val;
+    } else if (vbo != KSO_NONE && !kso_get_ci(vbo, &buf)) {
+        return NULL;
+    }
+
+    ks_list ents = ks_list_newi(fmt);
+    if (!ents) {
+        return NULL;
+    }
+
+    struct my_attrib* attrs = ks_malloc(sizeof(*attrs) * (ents->len > 0 ? ents->len : 1));
+    if (!attrs) {
+        KS_DECREF(ents);
+        KS_THROW(kst_Error, "Failed to allocate data");
+        return NULL;
+    }
+
+    /* Compute offsets, with each attribute aligned to 4 bytes (which some hardware requires) */
+    ks_ssize_t stride = 0, len = ents->len;
+    int i, n = 0;
+    for (i = 0; i < len; ++i) {
+        if (!my_getattrib(ents->elems[i], &attrs[i])) {
+            break;
+        }
+        n++;
+        attrs[i].offset = stride;
+        stride += (my_attribsize(attrs[i].type, attrs[i].size) + 3) / 4 * 4;
+    }
+    KS_DECREF(ents);
+
+    ks_dict idxs = NULL;
+    if (n == len) {
+        idxs = ks_dict_new(NULL);
+
+        glBindVertexArray(self->val);
+        if (buf >= 0) glBindBuffer(GL_ARRAY_BUFFER, buf);
+
+        int idx = first;
+        for (i = 0; i < n; ++i) {
+            struct my_attrib* a = &attrs[i];
+
+            /* Entries without names are padding */
+            if (a->name == KSO_NONE) continue;
+
+            void* ptr = (void*)(offset + a->offset);
+            if (a->type == GL_DOUBLE) {
+                glVertexAttribLPointer(idx, a->size, a->type, stride, ptr);
+            } else if (my_isint(a->type) && !a->normalize) {
+                glVertexAttribIPointer(idx, a->size, a->type, stride, ptr);
+            } else {
+                glVertexAttribPointer(idx, a->size, a->type, a->normalize ? GL_TRUE : GL_FALSE, stride, ptr);
+            }
+            glVertexAttribDivisor(idx, divisor);
+            glEnableVertexAttribArray(idx);
+
+            ks_int k = ks_int_new(idx);
+            ks_dict_set(idxs, a->name, (kso)k);
+            KS_DECREF(k);
+            idx++;
+        }
+
+        if (idx > self->n_layout) self->n_layout = idx;
+    }
+
+    for (i = 0; i < n; ++i) {
+        KS_DECREF(attrs[i].name);
+    }
+    ks_free(attrs);
+
+    if (!idxs) {
+        return NULL;
+    } else if (!ksgl_check()) {
+        KS_DECREF(idxs);
+        return NULL;
+    }
+
+    return (kso)ks_tuple_newn(2, (kso[]) {
+        (kso)ks_int_new(stride),
+        (kso)idxs
+    });
+}
+
 static KS_TFUNC(T, attrib_enable) {
     ksgl_vao self;
     ks_cint index;
@@ -125,6 +314,8 @@ void _ksgl_vao() {
 
         {"attrib",                 ksf_wrap(T_attrib_, T_NAME ".attrib(self, index, size, type, normalize, stride, offset=0)", "Add an attribute pointer to the vao, and enables it")},
 
+        {"layout",                 ksf_wrap(T_layout_, T_NAME ".layout(self, fmt, vbo=none, divisor=0, first=-1, offset=0)", "Bind this vertex array, and add interleaved attributes from 'vbo' (default: the currently bound buffer), described by 'fmt', a list of '(name, size, type)' or '(name, size, type, normalize)' entries. Offsets and the stride are computed (with each attribute aligned to 4 bytes), and entries with a 'none' name are padding. Integer types that are not normalized are read as integers (i.e. 'ivec4' in GLSL), and 'gl.DOUBLE' requires OpenGL v4.1. Attributes get consecutive indices starting at 'first' (default: after the previous layout, so each call can describe another stream), and advance once per 'divisor' instances if it is non-zero. Returns a tuple of '(stride, indices)', where 'indices' is a dict of names to attribute indices")},
+
         {"attrib_enable",          ksf_wrap(T_attrib_enable_, T_NAME ".attrib_enable(self, index)", "Enables a vertex attribute")},
         {"attrib_disable",         ksf_wrap(T_attrib_disable_, T_NAME ".attrib_disable(self, index)", "Disables a vertex attribute")},
 
@@ -9,15 +9,192 @@
 
 /* Internals */
 
+/* Flags for persistent buffers, which are mapped once for their whole lifetime */
+#define KSGL_PERSISTENT_FLAGS (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+
+/* Writes taking longer than this (in seconds), beyond the time to copy the data, are counted as stalls */
+#define KSGL_STALL_TIME 0.001
+
+/* Rate (in bytes per second) that copies are assumed to run at, when deciding if a write stalled */
+#define KSGL_COPY_RATE 2e9
+
+/* Names of the ways of writing, indexed by KSGL_WRITE_* */
+static const char* my_modes[KSGL_WRITE_N] = { "subdata", "orphan", "invalidate_range", "unsynchronized" };
+
+/* Owner of the memory of a non-persistent mapping, which views from 'map()' (and views of them) reference
+ * It keeps the buffer alive while they are, and tells it when the last one is released
+ */
+typedef struct my_mapref_s {
+    KSO_BASE
+
+    /* Buffer that was mapped */
+    ksgl_vbo vbo;
+
+}* my_mapref;
+
+static ks_type my_mapreft = NULL;
+
+static KS_TFUNC(MR, free) {
+    my_mapref self;
+    KS_ARGS("self:*", &self, my_mapreft);
+
+    if (self->vbo->map_ref == (kso)self) self->vbo->map_ref = NULL;
+    KS_DECREF(self->vbo);
+
+    KSO_DEL(self);
+    return KSO_NONE;
+}
+
+/* Set the fields of a buffer that is not created yet */
+static void my_clear(ksgl_vbo self, int usage, bool persistent) {
+    self->val = -1;
+    self->size = 0;
+    self->map = NULL;
+    self->map_offset = 0;
+    self->map_ref = NULL;
+    self->persistent = persistent;
+    self->usage = usage;
+
+    int i;
+    for (i = 0; i < KSGL_WRITE_N; ++i) {
+        self->n_writes[i] = self->n_stalls[i] = 0;
+        self->t_writes[i] = 0;
+    }
+}
+
+
 /* C-API */
 
+bool ksgl_vbo_init(ksgl_vbo self, ks_ssize_t size, const void* data, int usage) {
+    my_clear(self, usage, false);
+
+    self->val = ksgl_genbuffer();
+    glBindBuffer(GL_ARRAY_BUFFER, self->val);
+    glBufferData(GL_ARRAY_BUFFER, size, data, usage);
+    if (!ksgl_check()) {
+        return false;
+    }
+    self->size = size;
+
+    return true;
+}
+
+ksgl_vbo ksgl_vbo_new(ks_ssize_t size, int usage) {
+    ksgl_vbo self = KSO_NEW(ksgl_vbo, ksglt_vbo);
+    if (!ksgl_vbo_init(self, size, NULL, usage)) {
+        KS_DECREF(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+bool ksgl_vbo_write(ksgl_vbo self, ks_ssize_t offset, const void* data, ks_ssize_t len, int mode) {
+    if (offset < 0 || (mode != KSGL_WRITE_ORPHAN && offset + len > self->size)) {
+        KS_THROW(kst_SizeError, "Range [%i, %i) is out of bounds for buffer of %i bytes", (int)offset, (int)(offset + len), (int)self->size);
+        return false;
+    } else if (self->map && !self->persistent) {
+        KS_THROW(kst_Error, "Buffer is mapped (use 'unmap()' first)");
+        return false;
+    } else if (mode == KSGL_WRITE_ORPHAN && self->persistent) {
+        KS_THROW(kst_Error, "Persistent buffers cannot be orphaned");
+        return false;
+    }
+
+    double st = ksgl_time();
+    glBindBuffer(GL_ARRAY_BUFFER, self->val);
+
+    if (mode == KSGL_WRITE_SUBDATA) {
+        glBufferSubData(GL_ARRAY_BUFFER, offset, len, data);
+    } else if (mode == KSGL_WRITE_ORPHAN) {
+        /* Give the old storage to the driver (which frees it once the GPU is done), and write to new storage */
+        if (offset == 0 && len >= self->size) {
+            glBufferData(GL_ARRAY_BUFFER, len, data, self->usage);
+            self->size = len;
+        } else if (offset + len > self->size) {
+            KS_THROW(kst_SizeError, "Range [%i, %i) is out of bounds for buffer of %i bytes", (int)offset, (int)(offset + len), (int)self->size);
+            return false;
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, self->size, NULL, self->usage);
+            glBufferSubData(GL_ARRAY_BUFFER, offset, len, data);
+        }
+    } else if (self->persistent) {
+        /* Already mapped, and coherent */
+        memcpy((unsigned char*)self->map + offset, data, len);
+    } else if (len > 0) {
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        if (mode == KSGL_WRITE_INVALIDATE) access |= GL_MAP_INVALIDATE_RANGE_BIT;
+
+        void* dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, len, access);
+        if (!dst) {
+            if (ksgl_check()) KS_THROW(kst_Error, "Failed to map buffer");
+            return false;
+        }
+        memcpy(dst, data, len);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    if (!ksgl_check()) {
+        return false;
+    }
+
+    /* Anything much slower than copying the data means the driver waited for the GPU */
+    double el = ksgl_time() - st;
+    self->n_writes[mode]++;
+    self->t_writes[mode] += el;
+    if (el > KSGL_STALL_TIME + len / KSGL_COPY_RATE) {
+        self->n_stalls[mode]++;
+    }
+
+    return true;
+}
+
+bool ksgl_vbo_resize(ksgl_vbo self, ks_ssize_t size, bool preserve) {
+    if (size < 0) {
+        KS_THROW(kst_Error, "Buffer size must be non-negative, but got %i", (int)size);
+        return false;
+    } else if (self->persistent) {
+        KS_THROW(kst_Error, "Persistent buffers cannot be resized");
+        return false;
+    } else if (self->map) {
+        KS_THROW(kst_Error, "Buffer is mapped (use 'unmap()' first)");
+        return false;
+    }
+
+    ks_ssize_t keep = preserve ? (size < self->size ? size : self->size) : 0;
+
+    /* Re-specifying the storage discards it, so stash the contents in a temporary buffer first */
+    GLuint tmp = 0;
+    if (keep > 0) {
+        glGenBuffers(1, &tmp);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, tmp);
+        glBufferData(GL_COPY_WRITE_BUFFER, keep, NULL, GL_STREAM_COPY);
+        glBindBuffer(GL_COPY_READ_BUFFER, self->val);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, keep);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, self->val);
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, self->usage);
+
+    if (keep > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, tmp);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, self->val);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, keep);
+        glDeleteBuffers(1, &tmp);
+    }
+
+    self->size = size;
+    return ksgl_check();
+}
+
 /* Type Functions */
 
 static KS_TFUNC(T, free) {
     ksgl_vbo self;
     KS_ARGS("self:*", &self, ksglt_vbo);
 
-    if (self->val >= 0) glDeleteBuffers(1, (GLuint[]){ self->val });
+    /* Immutable storage can't be respecified, so persistent buffers are never recycled */
+    if (self->val >= 0) ksgl_delete(KSGL_OBJ_BUFFER, self->val, !self->persistent);
 
     KSO_DEL(self);
     return KSO_NONE;
@@ -29,30 +206,56 @@ static KS_TFUNC(T, init) {
     ksgl_vbo self;
     kso data = KSO_NONE;
     ks_cint usage = GL_STATIC_DRAW;
-    KS_ARGS("self:* ?data ?usage:cint", &self, ksglt_vbo, &data, &usage);
+    bool persistent = false;
+    KS_ARGS("self:* ?data ?usage:cint ?persistent:bool", &self, ksglt_vbo, &data, &usage, &persistent);
 
-    self->val = -1;
+    my_clear(self, usage, persistent);
+
+    if (persistent && !ksgl_hasstorage()) {
+        KS_THROW(kst_Error, "Persistent buffers require OpenGL v4.4 or 'ARB_buffer_storage'");
+        return NULL;
+    }
 
     /* Create buffer object */
-    GLuint t;
-    glGenBuffers(1, &t);
-    self->val = t;
+    self->val = ksgl_genbuffer();
     if (!ksgl_check()) {
         return NULL;
     }
 
-    /* Convert the data to its bytes equivalent */
-    ks_bytes data_bytes = kso_bytes(data);
-    if (!data_bytes) {
+    /* Get the bytes, which point into 'data' if it is a dense array, or just a size */
+    struct ksgl_data bytes = { NULL, 0, NULL };
+    if (kso_is_int(data)) {
+        ks_cint sz;
+        if (!kso_get_ci(data, &sz)) {
+            return NULL;
+        } else if (sz < 0) {
+            KS_THROW(kst_Error, "Buffer size must be non-negative, but got %i", (int)sz);
+            return NULL;
+        }
+        bytes.len = sz;
+    } else if (!ksgl_data_get(data, &bytes)) {
         return NULL;
     }
+    self->size = bytes.len;
 
     /* Bind as the currently used buffer */
     glBindBuffer(GL_ARRAY_BUFFER, self->val);
-    glBufferData(GL_ARRAY_BUFFER, data_bytes->len_b, data_bytes->data, usage);
+    if (persistent) {
+        glBufferStorage(GL_ARRAY_BUFFER, bytes.len, bytes.data, KSGL_PERSISTENT_FLAGS | GL_DYNAMIC_STORAGE_BIT);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, bytes.len, bytes.data, usage);
+    }
 
     /* Done with the bytes */
-    KS_DECREF(data_bytes);
+    if (bytes.data) ksgl_data_done(&bytes);
+
+    if (persistent && self->size > 0) {
+        self->map = glMapBufferRange(GL_ARRAY_BUFFER, 0, self->size, KSGL_PERSISTENT_FLAGS);
+        if (!self->map) {
+            if (ksgl_check()) KS_THROW(kst_Error, "Failed to map buffer");
+            return NULL;
+        }
+    }
 
     if (!ksgl_check()) {
         return NULL;
@@ -69,12 +272,149 @@ static KS_TFUNC(T, integral) {
     return (kso)ks_int_new(self->val);
 }
 
+static KS_TFUNC(T, getattr) {
+    ksgl_vbo self;
+    ks_str attr;
+    KS_ARGS("self:* attr:*", &self, ksglt_vbo, &attr, kst_str);
+
+    if (ks_str_eq_c(attr, "size", 4)) {
+        return (kso)ks_int_new(self->size);
+    } else if (ks_str_eq_c(attr, "persistent", 10)) {
+        return KSO_BOOL(self->persistent);
+    } else if (ks_str_eq_c(attr, "mapped", 6)) {
+        return KSO_BOOL(self->map != NULL);
+    } else if (ks_str_eq_c(attr, "write_stats", 11)) {
+        ks_dict res = ks_dict_new(NULL);
+        int i;
+        for (i = 0; i < KSGL_WRITE_N; ++i) {
+            ks_str k = ks_str_new(-1, my_modes[i]);
+            ks_tuple v = ks_tuple_newn(3, (kso[]) {
+                (kso)ks_int_new(self->n_writes[i]),
+                (kso)ks_int_new(self->n_stalls[i]),
+                (kso)ks_float_new(self->t_writes[i])
+            });
+            ks_dict_set(res, (kso)k, (kso)v);
+            KS_DECREF(k);
+            KS_DECREF(v);
+        }
+        return (kso)res;
+    }
 
-static KS_TFUNC(T, bind) {
+    KS_THROW_ATTR(self, attr);
+    return NULL;
+}
+
+static KS_TFUNC(T, map) {
+    ksgl_vbo self;
+    ks_cint offset = 0, size = -1;
+    ks_cint access = GL_MAP_WRITE_BIT;
+    nx_dtype dtype = nxd_u8;
+    KS_ARGS("self:* ?offset:cint ?size:cint ?access:cint ?dtype:*", &self, ksglt_vbo, &offset, &size, &access, &dtype, nxt_dtype);
+
+    if (size < 0) size = self->size - offset;
+    if (offset < 0 || size < 0 || offset + size > self->size) {
+        KS_THROW(kst_SizeError, "Range [%i, %i) is out of bounds for buffer of %i bytes", (int)offset, (int)(offset + size), (int)self->size);
+        return NULL;
+    } else if (size % dtype->size != 0) {
+        KS_THROW(kst_SizeError, "Size (%i bytes) is not a multiple of the element size (%i bytes)", (int)size, (int)dtype->size);
+        return NULL;
+    }
+
+    unsigned char* ptr;
+    if (self->persistent) {
+        /* Already mapped, so view part of it */
+        ptr = (unsigned char*)self->map + offset;
+    } else {
+        if (self->map) {
+            KS_THROW(kst_Error, "Buffer is already mapped (use 'unmap()' first)");
+            return NULL;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, self->val);
+        ptr = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, access);
+        if (!ptr) {
+            if (ksgl_check()) KS_THROW(kst_Error, "Failed to map buffer");
+            return NULL;
+        }
+        self->map = ptr;
+        self->map_offset = offset;
+    }
+
+    /* The view holds a reference to the buffer, so persistent mappings stay valid while it is alive */
+    kso ref = (kso)self;
+    if (!self->persistent) {
+        /* Otherwise, it references an object that tells 'unmap()' whether it (or a view of it) is still in use */
+        my_mapref mr = KSO_NEW(my_mapref, my_mapreft);
+        KS_INCREF(self);
+        mr->vbo = self;
+        self->map_ref = ref = (kso)mr;
+    }
+
+    kso res = (kso)nx_view_newo(nxt_view, nx_make(ptr, dtype, 1, (ks_size_t[]){ size / dtype->size }, NULL), ref);
+    if (!self->persistent) KS_DECREF(ref);
+
+    return res;
+}
+
+static KS_TFUNC(T, unmap) {
     ksgl_vbo self;
     KS_ARGS("self:*", &self, ksglt_vbo);
 
+    /* Persistent buffers stay mapped */
+    if (self->persistent || !self->map) {
+        return KSO_NONE;
+    }
+
+    /* The view (and views of it) would point to unmapped memory */
+    if (self->map_ref) {
+        KS_THROW(kst_Error, "Buffer cannot be unmapped while views from 'map()' are still in use");
+        return NULL;
+    }
+
     glBindBuffer(GL_ARRAY_BUFFER, self->val);
+    GLboolean ok = glUnmapBuffer(GL_ARRAY_BUFFER);
+    self->map = NULL;
+    if (!ksgl_check()) {
+        return NULL;
+    } else if (!ok) {
+        KS_THROW(kst_Error, "Buffer contents were lost while mapped, and must be written again");
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+
+static KS_TFUNC(T, bind) {
+    ksgl_vbo self;
+    ks_cint target = GL_ARRAY_BUFFER;
+    KS_ARGS("self:* ?target:cint", &self, ksglt_vbo, &target);
+
+    glBindBuffer(target, self->val);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, bind_storage) {
+    ksgl_vbo self;
+    ks_cint binding, offset = 0, size = -1;
+    KS_ARGS("self:* binding:cint ?offset:cint ?size:cint", &self, ksglt_vbo, &binding, &offset, &size);
+
+    if (size < 0 && offset == 0) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, self->val);
+    } else {
+        if (size < 0) {
+            /* Bind the rest of the buffer */
+            GLint tsz = 0;
+            glBindBuffer(GL_ARRAY_BUFFER, self->val);
+            glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &tsz);
+            size = tsz - offset;
+        }
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, self->val, offset, size);
+    }
     if (!ksgl_check()) {
         return NULL;
     }
@@ -99,23 +439,29 @@ static KS_TFUNC(T, write) {
     ksgl_vbo self;
     kso data;
     ks_cint offset = 0;
-    KS_ARGS("self:* data ?offset:cint", &self, ksglt_vbo, &data, &offset);
-
-    /* Bind for writing */
-    glBindBuffer(GL_ARRAY_BUFFER, self->val);
-    if (!ksgl_check()) {
-        return NULL;
+    ks_str mode = NULL;
+    KS_ARGS("self:* data ?offset:cint ?mode:*", &self, ksglt_vbo, &data, &offset, &mode, kst_str);
+
+    int m = KSGL_WRITE_SUBDATA;
+    if (mode) {
+        for (m = 0; m < KSGL_WRITE_N; ++m) {
+            if (ks_str_eq_c(mode, my_modes[m], strlen(my_modes[m]))) break;
+        }
+        if (m >= KSGL_WRITE_N) {
+            KS_THROW(kst_Error, "Unknown write mode %R (expected 'subdata', 'orphan', 'invalidate_range' or 'unsynchronized')", mode);
+            return NULL;
+        }
     }
 
-    /* Convert the data to its bytes equivalent */
-    ks_bytes data_bytes = kso_bytes(data);
-    if (!data_bytes) {
+    /* Get the bytes, which point into 'data' if it is a dense array */
+    struct ksgl_data bytes;
+    if (!ksgl_data_get(data, &bytes)) {
         return NULL;
     }
 
-    glBufferSubData(GL_ARRAY_BUFFER, offset, data_bytes->len_b, data_bytes->data);
-    KS_DECREF(data_bytes);
-    if (!ksgl_check()) {
+    bool ok = ksgl_vbo_write(self, offset, bytes.data, bytes.len, m);
+    ksgl_data_done(&bytes);
+    if (!ok) {
         return NULL;
     }
 
@@ -158,22 +504,96 @@ static KS_TFUNC(T, read) {
     return (kso)ks_bytes_newn(sz, data);
 }
 
+static KS_TFUNC(T, resize) {
+    ksgl_vbo self;
+    ks_cint size;
+    bool preserve = true;
+    KS_ARGS("self:* size:cint ?preserve:bool", &self, ksglt_vbo, &size, &preserve);
+
+    if (!ksgl_vbo_resize(self, size, preserve)) {
+        return NULL;
+    }
+
+    return KSO_NONE;
+}
+
+static KS_TFUNC(T, read_into) {
+    ksgl_vbo self;
+    kso out;
+    ks_cint offset = 0;
+    KS_ARGS("self:* out ?offset:cint", &self, ksglt_vbo, &out, &offset);
+
+    nx_t x;
+    if (!ksgl_getout(out, &x)) {
+        return NULL;
+    }
+
+    ks_ssize_t sz = x.dtype->size * nx_szprod(x.rank, x.shape);
+    if (offset < 0 || offset + sz > self->size) {
+        KS_THROW(kst_SizeError, "Range [%i, %i) is out of bounds for buffer of %i bytes", (int)offset, (int)(offset + sz), (int)self->size);
+        return NULL;
+    }
+
+    /* Read directly into the array */
+    glBindBuffer(GL_ARRAY_BUFFER, self->val);
+    glGetBufferSubData(GL_ARRAY_BUFFER, offset, sz, x.data);
+    if (!ksgl_check()) {
+        return NULL;
+    }
+
+    return KS_NEWREF(out);
+}
+
+static KS_TFUNC(T, read_async) {
+    ksgl_vbo self;
+    ks_cint sz = -1;
+    ks_cint offset = 0;
+    kso dtype = KSO_NONE;
+    KS_ARGS("self:* ?sz:cint ?offset:cint ?dtype", &self, ksglt_vbo, &sz, &offset, &dtype);
+
+    if (dtype != KSO_NONE && !kso_issub(dtype->type, nxt_dtype)) {
+        KS_THROW(kst_TypeError, "Expected 'dtype' to be an 'nx.dtype' or 'none', but got '%T' object", dtype);
+        return NULL;
+    }
+
+    if (sz < 0) sz = self->size - offset;
+    if (offset < 0 || sz < 0 || offset + sz > self->size) {
+        KS_THROW(kst_SizeError, "Range [%i, %i) is out of bounds for buffer of %i bytes", (int)offset, (int)(offset + sz), (int)self->size);
+        return NULL;
+    }
+
+    return (kso)ksgl_readback_new(self->val, offset, sz, dtype == KSO_NONE ? NULL : (nx_dtype)dtype);
+}
+
 /* Export */
 
 ks_type ksglt_vbo;
 
 void _ksgl_vbo() {
+    my_mapreft = ks_type_new(T_NAME ".mapping", kst_object, sizeof(struct my_mapref_s), -1, "Memory of a mapped buffer, referenced by views from 'map()'", KS_IKV(
+        {"__free",                 ksf_wrap(MR_free_, T_NAME ".mapping.__free(self)", "")},
+    ));
+
     ksglt_vbo = ks_type_new(T_NAME, kst_object, sizeof(struct ksgl_vbo_s), -1, "OpenGL vertex buffer object (VBO)", KS_IKV(
         {"__free",                 ksf_wrap(T_free_, T_NAME ".__free(self)", "")},
-        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, data='', usage=gl.STATIC_DRAW)", "")},
+        {"__init",                 ksf_wrap(T_init_, T_NAME ".__init(self, data='', usage=gl.STATIC_DRAW, persistent=false)", "If 'data' is an integer, an uninitialized buffer of that many bytes is created. If 'persistent' is true, the buffer is created with immutable storage and stays mapped (coherently) for its lifetime, so views from 'map()' can be written at any time (requires OpenGL v4.4 or 'ARB_buffer_storage')")},
 
         {"__integral",             ksf_wrap(T_integral_, T_NAME ".__integral(self)", "Converts to an integer (the OpenGL handle)")},
+        {"__getattr",              ksf_wrap(T_getattr_, T_NAME ".__getattr(self, attr)", "")},
 
-        {"bind",                   ksf_wrap(T_bind_, T_NAME ".bind(self)", "Bind this vertex buffer object as the current one")},
+        {"bind",                   ksf_wrap(T_bind_, T_NAME ".bind(self, target=gl.ARRAY_BUFFER)", "Bind this vertex buffer object as the current one. With 'gl.ELEMENT_ARRAY_BUFFER' (and a VAO bound), indices are read from it, i.e. for slices of a 'gl.BufferArena'")},
         {"unbind",                 ksf_wrap(T_unbind_, T_NAME ".unbind(self)", "Unbind this vertex buffer object")},
+        {"bind_storage",           ksf_wrap(T_bind_storage_, T_NAME ".bind_storage(self, binding, offset=0, size=-1)", "Bind (part of) this buffer to the shader storage buffer 'binding' (see 'gl.ComputeShader.storage_binding()'), so shaders can read and write it. Requires OpenGL v4.3")},
+
+        {"resize",                 ksf_wrap(T_resize_, T_NAME ".resize(self, size, preserve=true)", "Resize the buffer to 'size' bytes, keeping the same handle (so VAOs stay valid). If 'preserve' is true, existing contents are kept by copying on the GPU, without a round trip through the CPU")},
 
         {"read",                   ksf_wrap(T_read_, T_NAME ".read(self, sz=-1, offset=0)", "Reads part of the buffer (default: all of the buffer), and returns a bytes object")},
-        {"write",                  ksf_wrap(T_write_, T_NAME ".write(self, data, offset=0)", "Writes a bytes-like object to the buffer at the given offset (default: beginning)")},
+        {"map",                    ksf_wrap(T_map_, T_NAME ".map(self, offset=0, size=-1, access=gl.MAP_WRITE_BIT, dtype=nx.uint8)", "Map part of the buffer (default: all of it) with 'glMapBufferRange()', and return a 1D 'nx' view of 'dtype' elements over the mapped memory. For non-persistent buffers, 'unmap()' throws while the view (or a view of it) is still in use, so it must be released first")},
+        {"unmap",                  ksf_wrap(T_unmap_, T_NAME ".unmap(self)", "Unmap the buffer, which throws if views from 'map()' are still referenced. Persistent buffers stay mapped")},
+
+        {"read_into",              ksf_wrap(T_read_into_, T_NAME ".read_into(self, out, offset=0)", "Reads the buffer at 'offset' directly into 'out' (a dense 'nx.array'), filling all of it, and returns 'out'")},
+        {"read_async",             ksf_wrap(T_read_async_, T_NAME ".read_async(self, sz=-1, offset=0, dtype=none)", "Start reading part of the buffer (default: all of the buffer) without waiting for the GPU, and return a 'gl.Readback' whose 'result()' is an 'nx' array of 'dtype' (or bytes, if 'dtype' is none)")},
+        {"write",                  ksf_wrap(T_write_, T_NAME ".write(self, data, offset=0, mode='subdata')", "Writes a bytes-like object to the buffer at the given offset (default: beginning). 'mode' may be 'subdata' ('glBufferSubData()', which waits if the GPU is using the buffer), 'orphan' (re-specify the storage first, which discards the rest of the buffer unless the whole buffer is written), 'invalidate_range' (map the range, discarding its old contents) or 'unsynchronized' (map without waiting, so the range must not be in use by the GPU). The 'write_stats' attribute is a dict of each mode to '(writes, stalls, seconds)'")},
 
 
     ));